@@ -1,5 +1,9 @@
 #include "api_request_parser.h"
 
+#include <iomanip>
+#include <random>
+#include <sstream>
+
 namespace http_handler {
 
     std::string ApiRequestParser::ParseQueryMapName(std::string_view query) {
@@ -15,13 +19,6 @@ namespace http_handler {
         return "";
     }
 
-    const model::Map* ApiRequestParser::GetMap(const std::string& map_name) const {
-        if (!map_name.empty()) {
-            return game_.FindMap(model::Map::Id{map_name});
-        }
-        return nullptr;
-    }
-
     json::array ApiRequestParser::GetRoads(const model::Map* map) {
         json::array roads;
 
@@ -67,6 +64,21 @@ namespace http_handler {
         return offices;
     }
 
+    void ApiRequestParser::RenderMaps() {
+        // Карты не меняются, пока работает сервер, поэтому их версия всегда нулевая
+        // Сжатые копии тоже готовятся один раз и отдаются всем клиентам, принимающим gzip
+        auto render = [this](std::string&& body, std::string&& etag) {
+            auto gzip_body = MakeGzipBody(body, compression_);
+            return RenderedResponse{std::make_shared<const std::string>(std::move(body)), std::move(gzip_body), std::move(etag)};
+        };
+
+        maps_response_ = render(json::serialize(GetMapsJson()), MakeETag("maps"sv, {}, 0));
+
+        for (const auto& map : game_.GetMaps()) {
+            map_responses_.emplace(map.GetId(), render(json::serialize(GetMapJson(&map)), MakeETag("map"sv, *map.GetId(), 0)));
+        }
+    }
+
     json::value ApiRequestParser::GetMapsJson() const {
         json::array maps_json;
 
@@ -93,64 +105,45 @@ namespace http_handler {
         return map_json;
     }
 
-    json::value ApiRequestParser::GetDogsList(const std::vector<model::Dog*>& dogs) {
-        json::object players;
-
-        for (const model::Dog* dog :  dogs) {
-            boost::string_view tmp = std::to_string(dog->GetId());
-            players.insert({{tmp, json::object{{{gmct::name, dog->GetName()}}}}});
-        }
-
-        return players;
+    bool ApiRequestParser::IsBinaryAccepted(std::string_view accept) {
+        return accept.find(ContentType::APPLICATION_OCTET_STREAM) != std::string_view::npos;
     }
 
-    json::array ApiRequestParser::GetPlayerBag(const model::Dog* dog) const {
-        json::array bag;
-
-        for (auto [id, type] : dog->GetBackpackContents()) {
-            json::object obj;
-            obj.insert({{gmct::id, id},
-                        {gmct::type, type}});
-
-            bag.emplace_back(std::move(obj));
-        }
-
-        return bag;
+    std::string ApiRequestParser::MakeETag(std::string_view kind, std::string_view map_id, uint64_t version) const {
+        std::ostringstream etag;
+        etag << '"' << etag_prefix_ << '-' << kind << '-'
+             << std::hex << std::hash<std::string_view>{}(map_id) << std::dec << '-' << version << '"';
+        return etag.str();
     }
 
-    json::object ApiRequestParser::GetPlayersToState(const std::vector<model::Dog*>& dogs) const {
-        json::object players;
-
-        for (const model::Dog* dog :  dogs) {
-            boost::string_view tmp = std::to_string(dog->GetId());
-
-            auto [dir, pos, speed] = dog->GetMovementParameters();
+    std::string ApiRequestParser::MakeETagPrefix() {
+        std::random_device random_device;
+        std::ostringstream prefix;
+        prefix << std::hex << std::setw(8) << std::setfill('0') << random_device();
+        return prefix.str();
+    }
 
-            players.insert({{tmp, json::object{{{gmct::pos, json::array{pos.x, pos.y}},
-                                                {gmct::speed, json::array{speed.horizontal, speed.vertical}},
-                                                {gmct::dir, direction_to_strv_.at(dir)},
-                                                {gmct::bag, GetPlayerBag(dog)},
-                                                {gmct::score, dog->GetScore()}}}}});
+    std::pair<std::string_view, std::string_view> ApiRequestParser::SplitQueryParams(std::string_view query) {
+        auto pos = query.find('?');
+        if (pos == std::string_view::npos) {
+            return {query, {}};
         }
 
-        return players;
+        return {query.substr(0, pos), query.substr(pos + 1)};
     }
 
-    json::value ApiRequestParser::GetGameState(const model::GameSession* game_session) const {
-        json::object lost_objects;
-
-        for (const auto& [id, loot] : game_session->GetLostObjects()) {
-            boost::string_view tmp = std::to_string(id);
+    std::optional<std::string_view> ApiRequestParser::FindQueryParam(std::string_view params, std::string_view name) {
+        while (!params.empty()) {
+            auto param = params.substr(0, params.find('&'));
+            params.remove_prefix(std::min(param.size() + 1, params.size()));
 
-            lost_objects.insert({{tmp, json::object{{gmct::type, loot.type},
-                                                    {gmct::pos, json::array{loot.pos.x, loot.pos.y}}}}});
+            auto eq = param.find('=');
+            if (param.substr(0, eq) == name) {
+                return eq == std::string_view::npos ? std::string_view{} : param.substr(eq + 1);
+            }
         }
 
-        json::object ans;
-        ans.insert({{gmct::players, GetPlayersToState(game_session->GetDogs())},
-                    {gmct::lostObjects, std::move(lost_objects)}});
-
-        return ans;
+        return std::nullopt;
     }
 
     std::string ApiRequestParser::ParseBearer(std::string_view query) {
@@ -168,4 +161,31 @@ namespace http_handler {
 
         return {query.data(), query.size()};
     }
-}
+
+    std::optional<model::Direction> ApiRequestParser::ParseMove(std::string_view body) {
+        static const std::unordered_map<std::string_view, model::Direction> strv_to_direction{{"L", model::Direction::LEFT},
+                                                                                             {"R", model::Direction::RIGHT},
+                                                                                             {"U", model::Direction::UP},
+                                                                                             {"D", model::Direction::DOWN},
+                                                                                             { "", model::Direction::STOP}};
+        try {
+            json::value player_data = json::parse(body);
+            const auto& move = player_data.at(gmct::move).as_string();
+            if (auto it = strv_to_direction.find({move.data(), move.size()}); it != strv_to_direction.end()) {
+                return it->second;
+            }
+        } catch(...) {
+        }
+        return std::nullopt;
+    }
+
+    std::optional<ApiRequestParser::JoinRequest> ApiRequestParser::ParseJoinRequest(std::string_view body) {
+        try {
+            json::value player_data = json::parse(body);
+            return JoinRequest{player_data.at(gmct::userName).as_string().data(),
+                               model::Map::Id{player_data.at(gmct::mapId).as_string().data()}};
+        } catch(...) {
+        }
+        return std::nullopt;
+    }
+}
\ No newline at end of file
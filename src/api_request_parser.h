@@ -7,94 +7,242 @@
 #include "response_maker.h"
 #include "game_model_content_type.h"
 #include "extra_data.h"
+#include "api_strands.h"
+#include "game_state_serializer.h"
+#include "compression.h"
 
+#include <charconv>
+#include <optional>
 #include <unordered_map>
+#include <variant>
 
 namespace http_handler {
     namespace net = boost::asio;
 
     namespace json = boost::json;
 
+    // Ответы к API: сформированные для конкретного запроса и отдающие заранее подготовленное тело
+    using ApiResponse = std::variant<StringResponse, SharedResponse>;
+
     class ApiRequestParser {
     public:
         // Ключи игровой модели для JSON
         using gmct = model::GameModelContentType<boost::string_view>;
 
         explicit ApiRequestParser(model::Game& game,
+                                  const ApiStrands& strands,
+                                  GameStateSerializer& state_serializer,
+                                  const CompressionOptions& compression,
                                   bool is_update_time_shift_automatic,
                                   extra_data::FrontendData&& frontend_data)
                 : game_(game)
-                , frontend_data_{std::move(frontend_data)} {
+                , strands_(strands)
+                , state_serializer_(state_serializer)
+                , compression_(compression)
+                , is_tick_enabled_(!is_update_time_shift_automatic)
+                , frontend_data_{std::move(frontend_data)}
+                , etag_prefix_{MakeETagPrefix()} {
             query_to_parser_type_.insert({ApiRequestType::join, ParserType::join});
             query_to_parser_type_.insert({ApiRequestType::players, ParserType::players});
             query_to_parser_type_.insert({ApiRequestType::state, ParserType::state});
             query_to_parser_type_.insert({ApiRequestType::action, ParserType::action});
 
-            if (!is_update_time_shift_automatic) {
-                query_to_parser_type_.insert({ApiRequestType::tick, ParserType::tick});
-            }
+            RenderMaps();
         }
 
         ApiRequestParser(const ApiRequestParser&) = delete;
         ApiRequestParser& operator=(const ApiRequestParser&) = delete;
 
+        // Тело запроса на вход в игру
+        struct JoinRequest {
+            std::string user_name;
+            model::Map::Id map_id;
+        };
+
+        // Что известно о запросе к API до того, как он встанет в очередь strand'а
+        struct RequestTarget {
+            // Карта, к игровой сессии которой относится запрос
+            std::optional<model::Map::Id> map_id;
+            // Разобранное тело запроса на вход в игру, nullopt - если тело некорректно или запрос другой
+            std::optional<JoinRequest> join;
+        };
+
+        // Выполняет запрос к API и передаёт ответ в send. Ответ на тик отправляется, только когда тик
+        // выполнен во всех игровых сессиях: запрос состояния, отправленный после ответа, видит результат тика.
+        // target - результат GetRequestTarget для этого запроса.
+        template <typename Body, typename Allocator, typename Send>
+        void HandleApiRequest(const http::request<Body, http::basic_fields<Allocator>>& req, std::string&& query,
+                              RequestTarget&& target, Send&& send) {
+            if (IsTickRequest(query)) {
+                ParseTickQuery(req, std::forward<Send>(send));
+                return;
+            }
+
+            const bool changes_session = IsSessionChangeRequest(query);
+            ApiResponse response = ParseApiRequest(req, std::move(query), std::move(target.join));
+
+            // Вход и действие игрока видны в снимке сессии, когда клиент получает ответ: запрос состояния,
+            // отправленный после ответа, видит их и без тика. Снимок публикуется один на все такие запросы,
+            // стоящие в очереди strand'а
+            model::GameSession* session = changes_session && target.map_id ? game_.FindGameSession(*target.map_id) : nullptr;
+            if (!session) {
+                std::visit([&send](auto&& response) {
+                    send(std::move(response));
+                }, std::move(response));
+                return;
+            }
+
+            strands_.PublishChanges(session, [send = std::forward<Send>(send), response = std::move(response)]() mutable {
+                std::visit([&send](auto&& response) {
+                    send(std::move(response));
+                }, std::move(response));
+            });
+        }
+
+        // Тело ответа сжимается, если клиент принимает gzip. Строковые тела собираются для каждого запроса
+        // и сжимаются на лету. Разделяемые тела сжимает тот, кто их выдаёт: карты и состояние игры
+        // сжимаются один раз на версию и раздаются всем клиентам.
+        // Тело запроса на вход в игру не разбирается повторно: его передают в join из GetRequestTarget
         template <typename Body, typename Allocator>
-        StringResponse ParseApiRequest(const http::request<Body, http::basic_fields<Allocator>>& req, std::string&& query) {
-            if (query.substr(0, std::min(ApiRequestType::maps.size(), query.size())) == ApiRequestType::maps) {
-                return ParseMapsQuery(std::forward<decltype(req)>(req), query);
+        ApiResponse ParseApiRequest(const http::request<Body, http::basic_fields<Allocator>>& req, std::string&& query,
+                                    std::optional<JoinRequest>&& join = std::nullopt) {
+            ApiResponse response = RouteApiRequest(req, std::move(query), std::move(join));
+            if (auto r = std::get_if<StringResponse>(&response)) {
+                CompressResponse(*r, req[http::field::accept_encoding], compression_);
             }
+            return response;
+        }
 
-            if (query_to_parser_type_.count(query)) {
-                switch (query_to_parser_type_.at(query)) {
-                    case ParserType::join:
-                        return ParseJoinQuery(std::forward<decltype(req)>(req));
-                    case ParserType::players:
-                        return ParsePlayersQuery(std::forward<decltype(req)>(req));
-                    case ParserType::state:
-                        return ParseStateQuery(std::forward<decltype(req)>(req));
-                    case ParserType::action:
-                        return ParseActionQuery(std::forward<decltype(req)>(req));
-                    case ParserType::tick:
-                        return ParseTickQuery(std::forward<decltype(req)>(req));
-                }
+        // Запросы, которые только читают состояние игровой сессии. Они обслуживаются из опубликованного
+        // снимка сессии в любом потоке и не встают в очередь strand'а вместе с тиками и действиями игроков.
+        bool IsSessionSnapshotRequest(std::string_view query) const {
+            auto it = query_to_parser_type_.find(SplitQueryParams(query).first);
+            return it != query_to_parser_type_.end()
+                   && (it->second == ParserType::players || it->second == ParserType::state);
+        }
+
+        // Запросы, которые изменяют собак игровой сессии: вход в игру и действие игрока
+        bool IsSessionChangeRequest(std::string_view query) const {
+            auto it = query_to_parser_type_.find(SplitQueryParams(query).first);
+            return it != query_to_parser_type_.end()
+                   && (it->second == ParserType::join || it->second == ParserType::action);
+        }
+
+        // Карта, к игровой сессии которой относится запрос: из тела запроса на вход в игру или по токену игрока.
+        // Для остальных запросов и запросов с некорректными данными карта не определена.
+        // Тело запроса на вход разбирается здесь один раз и затем передаётся в HandleApiRequest.
+        template <typename Body, typename Allocator>
+        RequestTarget GetRequestTarget(const http::request<Body, http::basic_fields<Allocator>>& req,
+                                       std::string_view query) const {
+            auto it = query_to_parser_type_.find(SplitQueryParams(query).first);
+            if (it == query_to_parser_type_.end()) {
+                return {};
             }
 
-            return MakeStringResponse(http::status::bad_request,
-                                      req.version(),
-                                      req.keep_alive(),
-                                      ContentType::APPLICATION_JSON,
-                                      ErrorMessages::badRequest);
+            switch (it->second) {
+                case ParserType::join:
+                    if (auto join = ParseJoinRequest(req.body())) {
+                        auto map_id = join->map_id;
+                        return {std::move(map_id), std::move(join)};
+                    }
+                    return {};
+                case ParserType::players:
+                case ParserType::state:
+                case ParserType::action:
+                    if (auto player = game_.FindPlayer(model::Player::Token{ParseBearer(req[http::field::authorization])})) {
+                        return {player->GetGameSession()->GetMap()->GetId(), std::nullopt};
+                    }
+                    return {};
+            }
+
+            return {};
+        }
+
+        // Запрос тика, если время сдвигается запросами, а не автоматически
+        bool IsTickRequest(std::string_view query) const {
+            return is_tick_enabled_ && SplitQueryParams(query).first == ApiRequestType::tick;
         }
 
+        // Токен из заголовка Authorization вида "Bearer <токен>", пустая строка - если заголовок некорректен
+        static std::string ParseBearer(std::string_view query);
+
+        // Направление из тела действия игрока вида {"move": "L"}, nullopt - если тело некорректно
+        static std::optional<model::Direction> ParseMove(std::string_view body);
+
+        // Тело запроса на вход в игру вида {"userName": "...", "mapId": "..."}, nullopt - если тело некорректно
+        static std::optional<JoinRequest> ParseJoinRequest(std::string_view body);
+
+        // Разделяет запрос на путь и строку параметров после '?'
+        static std::pair<std::string_view, std::string_view> SplitQueryParams(std::string_view query);
+
+        // Значение параметра name из строки параметров вида "a=1&b=2"
+        static std::optional<std::string_view> FindQueryParam(std::string_view params, std::string_view name);
+
     private:
         model::Game& game_;
+        const ApiStrands& strands_;
+        // Общий с WebSocket-подписками: тела состояния собираются один раз для всех клиентов
+        GameStateSerializer& state_serializer_;
+        const CompressionOptions compression_;
+        const bool is_tick_enabled_;
 
         extra_data::FrontendData frontend_data_;
 
+        // Уникален для каждого запуска сервера: версии сессий после перезапуска начинаются заново,
+        // и ETag, полученный клиентом от прошлого запуска, не должен совпасть с новым
+        const std::string etag_prefix_;
+
+        // Карты не меняются после загрузки игры, поэтому ответы на запросы карт готовятся один раз при запуске
+        struct RenderedResponse {
+            SharedBody::value_type body;
+            // Тело, сжатое в gzip; nullptr, если сжатие отключено или бесполезно
+            SharedBody::value_type gzip_body;
+            std::string etag;
+        };
+
+        RenderedResponse maps_response_;
+        std::unordered_map<model::Map::Id, RenderedResponse, model::Game::MapIdHasher> map_responses_;
+
         enum class ParserType {
             join,
             players,
             state,
-            action,
-            tick
+            action
         };
 
-        std::unordered_map<model::Direction, std::string_view> direction_to_strv_{{model::Direction::UP, "U"},
-                                                                                  {model::Direction::LEFT, "L"},
-                                                                                  {model::Direction::RIGHT, "R"},
-                                                                                  {model::Direction::DOWN, "D"},
-                                                                                  {model::Direction::STOP, ""}};
+        std::unordered_map<std::string_view, ParserType> query_to_parser_type_;
 
-        std::unordered_map<std::string_view, model::Direction> strv_to_direction_{{"L", model::Direction::LEFT},
-                                                                                  {"R", model::Direction::RIGHT},
-                                                                                  {"U", model::Direction::UP},
-                                                                                  {"D", model::Direction::DOWN},
-                                                                                  { "", model::Direction::STOP}};
+        template <typename Body, typename Allocator>
+        ApiResponse RouteApiRequest(const http::request<Body, http::basic_fields<Allocator>>& req, std::string&& query,
+                                    std::optional<JoinRequest>&& join) {
+            auto [path, params] = SplitQueryParams(query);
 
-        std::unordered_map<std::string_view, ParserType> query_to_parser_type_;
+            if (path.substr(0, std::min(ApiRequestType::maps.size(), path.size())) == ApiRequestType::maps) {
+                return ParseMapsQuery(std::forward<decltype(req)>(req), path);
+            }
+
+            if (query_to_parser_type_.count(path)) {
+                switch (query_to_parser_type_.at(path)) {
+                    case ParserType::join:
+                        return ParseJoinQuery(std::forward<decltype(req)>(req), std::move(join));
+                    case ParserType::players:
+                        return ParsePlayersQuery(std::forward<decltype(req)>(req));
+                    case ParserType::state:
+                        return ParseStateQuery(std::forward<decltype(req)>(req), params);
+                    case ParserType::action:
+                        return ParseActionQuery(std::forward<decltype(req)>(req));
+                }
+            }
+
+            return MakeStringResponse(http::status::bad_request,
+                                      req.version(),
+                                      req.keep_alive(),
+                                      ContentType::APPLICATION_JSON,
+                                      ErrorMessages::badRequest);
+        }
 
         template <typename Body, typename Allocator>
-        StringResponse ParseMapsQuery(const http::request<Body, http::basic_fields<Allocator>>& req, std::string_view query) const {
+        ApiResponse ParseMapsQuery(const http::request<Body, http::basic_fields<Allocator>>& req, std::string_view query) const {
             if (req.method() != http::verb::get && req.method() != http::verb::head) {
                 return MakeMethodNotAllowedResponse(http::status::method_not_allowed,
                                                     req.version(),
@@ -105,19 +253,11 @@ namespace http_handler {
             }
 
             if (query.size() == ApiRequestType::maps.size()) {
-                return MakeStringResponse(http::status::ok,
-                                          req.version(),
-                                          req.keep_alive(),
-                                          ContentType::APPLICATION_JSON,
-                                          json::serialize(GetMapsJson()));
+                return MakeRenderedResponse(req, maps_response_);
             }
 
-            if (auto map = GetMap(ParseQueryMapName(query))) {
-                return MakeStringResponse(http::status::ok,
-                                          req.version(),
-                                          req.keep_alive(),
-                                          ContentType::APPLICATION_JSON,
-                                          json::serialize(GetMapJson(map)));
+            if (auto it = map_responses_.find(model::Map::Id{ParseQueryMapName(query)}); it != map_responses_.end()) {
+                return MakeRenderedResponse(req, it->second);
             }
 
             return MakeStringResponse(http::status::not_found,
@@ -128,7 +268,8 @@ namespace http_handler {
         }
 
         template <typename Body, typename Allocator>
-        StringResponse ParseJoinQuery(const http::request<Body, http::basic_fields<Allocator>>& req) {
+        StringResponse ParseJoinQuery(const http::request<Body, http::basic_fields<Allocator>>& req,
+                                      std::optional<JoinRequest>&& join) {
             if (req.method() != http::verb::post) {
                 return MakeMethodNotAllowedResponse(http::status::method_not_allowed,
                                                     req.version(),
@@ -138,13 +279,7 @@ namespace http_handler {
                                                     "POST");
             }
 
-            std::string userName;
-            std::string mapId;
-            try {
-                json::value player_data = json::parse(req.body());
-                userName = player_data.at(gmct::userName).as_string().data();
-                mapId = player_data.at(gmct::mapId).as_string().data();
-            } catch(...) {
+            if (!join) {
                 return MakeStringResponse(http::status::bad_request,
                                           req.version(),
                                           req.keep_alive(),
@@ -152,7 +287,7 @@ namespace http_handler {
                                           ErrorMessages::invalidArgumentApiJoinJson);
             }
 
-            if (userName.empty()) {
+            if (join->user_name.empty()) {
                 return MakeStringResponse(http::status::bad_request,
                                           req.version(),
                                           req.keep_alive(),
@@ -160,7 +295,7 @@ namespace http_handler {
                                           ErrorMessages::invalidArgumentApiJoinName);
             }
 
-            auto add_player_result = game_.AddPlayer(std::move(userName), model::Map::Id{std::move(mapId)});
+            auto add_player_result = game_.AddPlayer(std::move(join->user_name), std::move(join->map_id));
 
             if (!add_player_result) {
                 return MakeStringResponse(http::status::not_found,
@@ -181,7 +316,7 @@ namespace http_handler {
         }
 
         template <typename Body, typename Allocator>
-        StringResponse ParsePlayersQuery(const http::request<Body, http::basic_fields<Allocator>>& req) {
+        ApiResponse ParsePlayersQuery(const http::request<Body, http::basic_fields<Allocator>>& req) {
             if (req.method() != http::verb::get && req.method() != http::verb::head) {
                 return MakeMethodNotAllowedResponse(http::status::method_not_allowed,
                                                     req.version(),
@@ -211,15 +346,33 @@ namespace http_handler {
                                           ErrorMessages::unknownToken);
             }
 
-            return MakeStringResponse(http::status::ok,
-                                      req.version(),
-                                      req.keep_alive(),
-                                      ContentType::APPLICATION_JSON,
-                                      json::serialize(GetDogsList(player->GetGameSession()->GetDogs())));
+            // Собаки только добавляются в сессию, поэтому их число и есть версия списка игроков
+            auto snapshot = player->GetGameSession()->GetSnapshot();
+            const auto& map_id = *player->GetGameSession()->GetMap()->GetId();
+
+            ApiResponse response;
+            if (IsBinaryAccepted(req[http::field::accept])) {
+                response = MakeTaggedResponse(req, MakeETag("players-bin"sv, map_id, snapshot->dogs.size()),
+                                              ContentType::APPLICATION_OCTET_STREAM, [&snapshot] {
+                    return std::make_shared<const std::string>(GameStateSerializer::SerializeDogsListBinary(snapshot->dogs));
+                });
+            } else {
+                response = MakeTaggedResponse(req, MakeETag("players"sv, map_id, snapshot->dogs.size()),
+                                              ContentType::APPLICATION_JSON, [&snapshot] {
+                    return std::make_shared<const std::string>(GameStateSerializer::SerializeDogsList(snapshot->dogs));
+                });
+            }
+            // Представление выбирается по заголовку Accept, и кэши должны это учитывать.
+            // Список собирается для каждого запроса, поэтому сжимается на лету
+            std::visit([this, &req](auto& r) {
+                r.set(http::field::vary, "Accept"sv);
+                CompressResponse(r, req[http::field::accept_encoding], compression_);
+            }, response);
+            return response;
         }
 
         template <typename Body, typename Allocator>
-        StringResponse ParseStateQuery(const http::request<Body, http::basic_fields<Allocator>>& req) {
+        ApiResponse ParseStateQuery(const http::request<Body, http::basic_fields<Allocator>>& req, std::string_view params) {
             if (req.method() != http::verb::get && req.method() != http::verb::head) {
                 return MakeMethodNotAllowedResponse(http::status::method_not_allowed,
                                                     req.version(),
@@ -249,11 +402,62 @@ namespace http_handler {
                                           ErrorMessages::unknownToken);
             }
 
-            return MakeStringResponse(http::status::ok,
-                                      req.version(),
-                                      req.keep_alive(),
-                                      ContentType::APPLICATION_JSON,
-                                      json::serialize(GetGameState(player->GetGameSession())));
+            // Без параметра since отдаём полное состояние в прежнем формате
+            std::optional<uint64_t> since;
+            if (auto since_param = FindQueryParam(params, ApiQueryParam::since)) {
+                uint64_t value;
+                auto [end, ec] = std::from_chars(since_param->data(), since_param->data() + since_param->size(), value);
+                if (ec != std::errc{} || end != since_param->data() + since_param->size()) {
+                    return MakeStringResponse(http::status::bad_request,
+                                              req.version(),
+                                              req.keep_alive(),
+                                              ContentType::APPLICATION_JSON,
+                                              ErrorMessages::invalidArgumentToParseSince);
+                }
+                since = value;
+            }
+
+            // Двоичный формат есть только у полного состояния, изменения с версии since всегда отдаются в JSON
+            const bool binary = !since && IsBinaryAccepted(req[http::field::accept]);
+            const std::string_view kind = binary ? "state-bin"sv : "state"sv;
+
+            // Для одной версии снимка ответ на один и тот же запрос не меняется, поэтому версия и служит ETag.
+            // Клиенту, у которого уже есть последняя версия, отвечаем без сериализации.
+            const model::GameSession* session = player->GetGameSession();
+            const auto& map_id = *session->GetMap()->GetId();
+            if (auto etag = MakeETag(kind, map_id, session->GetSnapshot()->version);
+                IsETagMatched(req[http::field::if_none_match], etag)) {
+                auto response = MakeNotModifiedResponse(req.version(), req.keep_alive(), etag);
+                response.set(http::field::vary, "Accept"sv);
+                return response;
+            }
+
+            auto state = binary ? state_serializer_.GetGameStateBinary(session)
+                                : since ? state_serializer_.GetGameStateDelta(session, *since)
+                                        : state_serializer_.GetGameState(session);
+
+            // Тело могло быть собрано из более нового снимка, чем проверенный выше, поэтому ETag берём из него.
+            // Ответ разделяет владение собранным телом с кэшем сериализатора, не копируя его.
+            // Сжатое тело тоже одно на версию: его получают все клиенты, принимающие gzip
+            const bool compressible = !binary && compression_.IsEnabled();
+            SharedBody::value_type gzip_body;
+            if (compressible && IsGzipAccepted(req[http::field::accept_encoding])) {
+                gzip_body = state->GetGzipBody(compression_);
+            }
+
+            auto response = MakeSharedResponse(http::status::ok,
+                                               req.version(),
+                                               req.keep_alive(),
+                                               binary ? ContentType::APPLICATION_OCTET_STREAM : ContentType::APPLICATION_JSON,
+                                               gzip_body ? gzip_body : SharedBody::value_type{state, &state->text});
+            response.set(http::field::etag, MakeETag(kind, map_id, state->version));
+            response.set(http::field::vary, "Accept"sv);
+            if (gzip_body) {
+                MarkGzipEncoded(response);
+            } else if (compressible) {
+                AddVary(response, "Accept-Encoding"sv);
+            }
+            return response;
         }
 
         template <typename Body, typename Allocator>
@@ -287,11 +491,8 @@ namespace http_handler {
                                           ErrorMessages::unknownToken);
             }
 
-            model::Direction dir;
-            try {
-                json::value player_data = json::parse(req.body());
-                dir = strv_to_direction_.at(player_data.at(gmct::move).as_string().data());
-            } catch(...) {
+            auto dir = ParseMove(req.body());
+            if (!dir) {
                 return MakeStringResponse(http::status::bad_request,
                                           req.version(),
                                           req.keep_alive(),
@@ -299,7 +500,7 @@ namespace http_handler {
                                           ErrorMessages::invalidArgumentToParseAction);
             }
 
-            player->SetDogMovementParameters(dir);
+            player->SetDogMovementParameters(*dir);
 
             return MakeStringResponse(http::status::ok,
                                       req.version(),
@@ -308,15 +509,17 @@ namespace http_handler {
                                       "{}");
         }
 
-        template <typename Body, typename Allocator>
-        StringResponse ParseTickQuery(const http::request<Body, http::basic_fields<Allocator>>& req) {
+        // Ошибки отправляются сразу, а ответ на выполненный тик - из strand'а сессии, закончившей его последней
+        template <typename Body, typename Allocator, typename Send>
+        void ParseTickQuery(const http::request<Body, http::basic_fields<Allocator>>& req, Send&& send) {
             if (req.method() != http::verb::post) {
-                return MakeMethodNotAllowedResponse(http::status::method_not_allowed,
-                                                    req.version(),
-                                                    req.keep_alive(),
-                                                    ContentType::APPLICATION_JSON,
-                                                    ErrorMessages::invalidMethodApiJoin,
-                                                    "POST");
+                send(MakeMethodNotAllowedResponse(http::status::method_not_allowed,
+                                                  req.version(),
+                                                  req.keep_alive(),
+                                                  ContentType::APPLICATION_JSON,
+                                                  ErrorMessages::invalidMethodApiJoin,
+                                                  "POST"));
+                return;
             }
 
             double time_delta;
@@ -333,24 +536,77 @@ namespace http_handler {
                     throw 1;
                 }
             } catch(...) {
-                return MakeStringResponse(http::status::bad_request,
-                                          req.version(),
-                                          req.keep_alive(),
-                                          ContentType::APPLICATION_JSON,
-                                          ErrorMessages::invalidArgumentToParseJSON);
+                send(MakeStringResponse(http::status::bad_request,
+                                        req.version(),
+                                        req.keep_alive(),
+                                        ContentType::APPLICATION_JSON,
+                                        ErrorMessages::invalidArgumentToParseJSON));
+                return;
             }
 
-            // В аргументе преобразуем секунды в миллисекунды
-            game_.SetTimeShift(time_delta / 1000.);
+            // В аргументе преобразуем секунды в миллисекунды. Ответ отправляется, когда тик закончили все сессии.
+            // Если тик какой-то сессии завершился ошибкой, клиент получает ошибку, а не пустой ответ об успехе
+            strands_.PostTimeShift(time_delta / 1000., [send = std::forward<Send>(send), version = req.version(),
+                                                        keep_alive = req.keep_alive()](bool all_ticked) mutable {
+                if (all_ticked) {
+                    send(MakeStringResponse(http::status::ok,
+                                            version,
+                                            keep_alive,
+                                            ContentType::APPLICATION_JSON,
+                                            "{}"));
+                } else {
+                    send(MakeStringResponse(http::status::internal_server_error,
+                                            version,
+                                            keep_alive,
+                                            ContentType::APPLICATION_JSON,
+                                            ErrorMessages::tickFailed));
+                }
+            });
+        }
 
-            return MakeStringResponse(http::status::ok,
-                                      req.version(),
-                                      req.keep_alive(),
-                                      ContentType::APPLICATION_JSON,
-                                      "{}");
+        // Ответ с тегом etag: 304, если эта версия ресурса уже есть у клиента, иначе тело, построенное make_body
+        template <typename Body, typename Allocator, typename MakeBody>
+        ApiResponse MakeTaggedResponse(const http::request<Body, http::basic_fields<Allocator>>& req,
+                                       const std::string& etag,
+                                       std::string_view content_type,
+                                       MakeBody&& make_body) const {
+            if (IsETagMatched(req[http::field::if_none_match], etag)) {
+                return MakeNotModifiedResponse(req.version(), req.keep_alive(), etag);
+            }
+
+            auto response = MakeSharedResponse(http::status::ok,
+                                               req.version(),
+                                               req.keep_alive(),
+                                               content_type,
+                                               make_body());
+            response.set(http::field::etag, etag);
+            return response;
         }
 
-        [[nodiscard]] const model::Map* GetMap(const std::string& map_name) const;
+        template <typename Body, typename Allocator>
+        ApiResponse MakeRenderedResponse(const http::request<Body, http::basic_fields<Allocator>>& req,
+                                         const RenderedResponse& rendered) const {
+            // Сжатое тело готово заранее, поэтому карта отдаётся в gzip без затрат на сжатие
+            const bool gzip = rendered.gzip_body && IsGzipAccepted(req[http::field::accept_encoding]);
+            ApiResponse response = MakeTaggedResponse(req, rendered.etag, ContentType::APPLICATION_JSON, [&rendered, gzip] {
+                return gzip ? rendered.gzip_body : rendered.body;
+            });
+            std::visit([gzip, &rendered](auto& r) {
+                if (gzip && r.result() == http::status::ok) {
+                    MarkGzipEncoded(r);
+                } else if (rendered.gzip_body) {
+                    AddVary(r, "Accept-Encoding"sv);
+                }
+            }, response);
+            return response;
+        }
+
+        void RenderMaps();
+
+        // ETag ресурса kind, относящегося к карте map_id (пустая строка - ко всей игре), в версии version
+        std::string MakeETag(std::string_view kind, std::string_view map_id, uint64_t version) const;
+
+        static std::string MakeETagPrefix();
 
         static std::string ParseQueryMapName(std::string_view query);
 
@@ -364,14 +620,8 @@ namespace http_handler {
 
         static json::array GetOffices(const model::Map* map);
 
-        static json::value GetDogsList(const std::vector<model::Dog*>& dogs);
-
-        json::array GetPlayerBag(const model::Dog* dog) const;
+        // Просит ли клиент двоичный формат. По умолчанию ответы отдаются в JSON
+        static bool IsBinaryAccepted(std::string_view accept);
 
-        json::object GetPlayersToState(const std::vector<model::Dog*>& dogs) const;
-
-        json::value GetGameState(const model::GameSession* game_session) const;
-
-        static std::string ParseBearer(std::string_view query);
     };
 }
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include "api_strands.h"
+
+#include <boost/asio/post.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <string_view>
+
+namespace http_handler {
+    using namespace std::string_view_literals;
+
+    namespace {
+        // Общее для тиков всех сессий состояние: сколько сессий ещё не закончили тик и была ли ошибка
+        struct TickProgress {
+            TickProgress(size_t sessions_count, ApiStrands::TickCompletion on_complete)
+                    : remaining(sessions_count)
+                    , on_complete(std::move(on_complete)) {
+            }
+
+            std::atomic<size_t> remaining;
+            std::atomic<bool> failed = false;
+            ApiStrands::TickCompletion on_complete;
+        };
+
+        // Отмечает, что сессия закончила тик, при любом выходе из обработчика тика - в том числе по исключению.
+        // Иначе счётчик не дойдёт до нуля, завершение тика не будет вызвано и тикер больше не запустит тики
+        class TickCountdown {
+        public:
+            explicit TickCountdown(std::shared_ptr<TickProgress> progress) noexcept
+                    : progress_(std::move(progress)) {
+            }
+
+            TickCountdown(const TickCountdown&) = delete;
+            TickCountdown& operator=(const TickCountdown&) = delete;
+
+            ~TickCountdown() {
+                // Последняя сессия видит результаты остальных и сообщает о завершении тика
+                if (progress_->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 && progress_->on_complete) {
+                    try {
+                        progress_->on_complete(!progress_->failed.load(std::memory_order_relaxed));
+                    } catch (...) {
+                    }
+                }
+            }
+
+        private:
+            std::shared_ptr<TickProgress> progress_;
+        };
+    }  // namespace
+
+    ApiStrands::ApiStrands(net::io_context& ioc, model::Game& game, Logger log)
+            : game_(game)
+            , log_(std::move(log))
+            , global_strand_(net::make_strand(ioc)) {
+        for (const auto& map : game.GetMaps()) {
+            map_strands_.emplace(map.GetId(), MapStrand{net::make_strand(ioc)});
+        }
+    }
+
+    const ApiStrands::Strand& ApiStrands::GetMapStrand(const model::Map::Id& map_id) const {
+        if (auto it = map_strands_.find(map_id); it != map_strands_.end()) {
+            return it->second.strand;
+        }
+        return global_strand_;
+    }
+
+    void ApiStrands::PublishChanges(model::GameSession* session, std::function<void()> on_published) const {
+        const MapStrand& map_strand = map_strands_.at(session->GetMap()->GetId());
+        assert(map_strand.strand.running_in_this_thread());
+
+        if (on_published) {
+            map_strand.waiting_for_publish.push_back(std::move(on_published));
+        }
+        if (map_strand.publish_scheduled) {
+            return;
+        }
+        map_strand.publish_scheduled = true;
+
+        // Набор strand'ов не меняется после создания, поэтому ссылка на map_strand остаётся действительной
+        net::post(map_strand.strand, [this, &map_strand, session] {
+            map_strand.publish_scheduled = false;
+            auto waiting = std::move(map_strand.waiting_for_publish);
+            map_strand.waiting_for_publish.clear();
+
+            try {
+                session->PublishChanges();
+            } catch (const std::exception& ex) {
+                LogSessionError(session, "publish"sv, ex.what());
+            } catch (...) {
+                LogSessionError(session, "publish"sv, "unknown error"sv);
+            }
+
+            for (auto& callback : waiting) {
+                callback();
+            }
+        });
+    }
+
+    void ApiStrands::PostTimeShift(double shift_time, TickCompletion on_complete) const {
+        auto sessions = game_.GetGameSessions();
+        if (sessions.empty()) {
+            if (on_complete) {
+                on_complete(true);
+            }
+            return;
+        }
+
+        // Сессии считают, сколько из них ещё не закончили тик
+        auto progress = std::make_shared<TickProgress>(sessions.size(), std::move(on_complete));
+
+        for (model::GameSession* session : sessions) {
+            net::post(GetMapStrand(session->GetMap()->GetId()), [this, session, shift_time, progress] {
+                TickCountdown countdown(progress);
+
+                // Исключение, вышедшее из обработчика на strand'е, завершило бы поток io_context и весь сервер
+                try {
+                    session->SetTimeShift(shift_time);
+                } catch (const std::exception& ex) {
+                    progress->failed.store(true, std::memory_order_relaxed);
+                    LogSessionError(session, "tick"sv, ex.what());
+                    return;
+                } catch (...) {
+                    progress->failed.store(true, std::memory_order_relaxed);
+                    LogSessionError(session, "tick"sv, "unknown error"sv);
+                    return;
+                }
+
+                if (tick_handler_) {
+                    try {
+                        tick_handler_(session);
+                    } catch (const std::exception& ex) {
+                        LogSessionError(session, "tick handler"sv, ex.what());
+                    } catch (...) {
+                        LogSessionError(session, "tick handler"sv, "unknown error"sv);
+                    }
+                }
+            });
+        }
+    }
+
+    void ApiStrands::LogSessionError(const model::GameSession* session, std::string_view where, std::string_view what) const {
+        if (!log_) {
+            return;
+        }
+        try {
+            json::value error_log{{"map", *session->GetMap()->GetId()},
+                                  {"text", json::string_view{what.data(), what.size()}},
+                                  {"where", json::string_view{where.data(), where.size()}}};
+
+            log_(std::move(error_log), "error"sv);
+        } catch (...) {
+        }
+    }
+
+}  // namespace http_handler
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/json.hpp>
+
+#include "model.h"
+
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace http_handler {
+    namespace net = boost::asio;
+    namespace json = boost::json;
+
+    // Последовательные исполнители для работы с игрой: по одному на каждую карту и её игровую сессию
+    // и общий - для операций, затрагивающих всю игру. Запросы к разным картам не ждут друг друга.
+    class ApiStrands {
+    public:
+        using Strand = net::strand<net::io_context::executor_type>;
+        // Вызывается на strand'е карты сразу после тика её игровой сессии
+        using TickHandler = std::function<void(const model::GameSession*)>;
+        // Вызывается один раз, когда тик выполнен во всех игровых сессиях.
+        // all_ticked ложен, если тик хотя бы одной сессии завершился ошибкой
+        using TickCompletion = std::function<void(bool all_ticked)>;
+        using Logger = std::function<void(json::value, std::string_view)>;
+
+        // Карты загружаются до запуска сервера, поэтому набор strand'ов после создания не меняется
+        // и читается из любого потока без синхронизации. В log записываются ошибки тиков и публикаций игровых сессий
+        ApiStrands(net::io_context& ioc, model::Game& game, Logger log = {});
+
+        ApiStrands(const ApiStrands&) = delete;
+        ApiStrands& operator=(const ApiStrands&) = delete;
+
+        const Strand& GetGlobalStrand() const noexcept {
+            return global_strand_;
+        }
+
+        // strand игровой сессии карты map_id, либо общий strand для неизвестной карты
+        const Strand& GetMapStrand(const model::Map::Id& map_id) const;
+
+        // Сдвигает время во всех игровых сессиях. Тик каждой сессии ставится в очередь strand'а её карты,
+        // поэтому сессии обрабатываются параллельно, а запросы, пришедшие после тика, видят его результат.
+        // on_complete вызывается на strand'е сессии, закончившей тик последней, после того как все сессии
+        // опубликовали снимки и отработал обработчик тика. Исключение из тика сессии или обработчика тика
+        // записывается в журнал и не выходит за пределы strand'а. on_complete вызывается и в этом случае,
+        // чтобы тикер не остановился. Если сессий нет, вызывается сразу.
+        void PostTimeShift(double shift_time, TickCompletion on_complete = {}) const;
+
+        // Публикует снимок игровой сессии с изменениями, которые сделали вход и действия игроков, и затем
+        // вызывает on_published. Вызывается на strand'е карты сессии. Публикация ставится в конец очереди
+        // strand'а, поэтому запросы, уже стоящие в очереди, публикуются одним снимком: при наплыве игроков
+        // снимок не пересобирается на каждый запрос. Ответ, отправленный из on_published, клиент получает,
+        // когда его изменения уже видны в /api/v1/game/state и /api/v1/game/players.
+        void PublishChanges(model::GameSession* session, std::function<void()> on_published = {}) const;
+
+        // Задаётся до запуска сервера, пока тики ещё не выполняются
+        void SetTickHandler(TickHandler handler) {
+            tick_handler_ = std::move(handler);
+        }
+
+    private:
+        void LogSessionError(const model::GameSession* session, std::string_view where, std::string_view what) const;
+
+        // strand карты и ожидающая его публикация. Поля публикации изменяются только на этом strand'е
+        struct MapStrand {
+            Strand strand;
+            mutable bool publish_scheduled = false;
+            mutable std::vector<std::function<void()>> waiting_for_publish;
+        };
+
+        model::Game& game_;
+        Logger log_;
+        Strand global_strand_;
+        std::unordered_map<model::Map::Id, MapStrand, model::Game::MapIdHasher> map_strands_;
+        TickHandler tick_handler_;
+    };
+
+}  // namespace http_handler
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace http_handler {
+
+    // Дописывает в строку целые числа фиксированной ширины в порядке little-endian независимо от платформы.
+    //
+    // Двоичные ответы /api/v1/game/state и /api/v1/game/players (Accept: application/octet-stream)
+    // начинаются с заголовка из 24 байт:
+    //   uint8  kind      1 - состояние, 2 - список игроков
+    //   uint8  format    версия формата, сейчас 2
+    //   uint16 reserved  0
+    //   uint32 count[3]  число записей в секциях, следующих за заголовком
+    //   uint64 version   версия снимка сессии (для списка игроков - число игроков)
+    //
+    // Состояние: count = {собаки, предметы в рюкзаках, предметы на карте}
+    //   собака, 32 байта:  uint32 id, int32 x, int32 y, int32 vx, int32 vy, uint32 score, uint32 bag_size,
+    //                      uint8 dir (0 - U, 1 - D, 2 - L, 3 - R, 4 - стоит), uint8 reserved[3]
+    //                      Вместимость рюкзака не ограничивает bag_size, поэтому поле той же ширины, что count
+    //   предмет в рюкзаке, 8 байт: uint32 id, uint32 type - подряд для всех собак в порядке их записей
+    //   предмет на карте, 16 байт: uint32 id, uint32 type, int32 x, int32 y
+    // Координаты и скорости - в тысячных долях единицы карты.
+    //
+    // Список игроков: count = {игроки, байт в именах, 0}
+    //   игрок, 8 байт: uint32 id, uint32 name_size, затем имена в UTF-8 подряд в порядке записей
+    class BinaryWriter {
+    public:
+        enum class Kind : std::uint8_t {
+            state = 1,
+            players = 2
+        };
+
+        constexpr static std::uint8_t kFormat = 2;
+        constexpr static double kCoordScale = 1000.;
+
+        explicit BinaryWriter(std::string& out)
+                : out_(out) {
+        }
+
+        BinaryWriter(const BinaryWriter&) = delete;
+        BinaryWriter& operator=(const BinaryWriter&) = delete;
+
+        BinaryWriter& Header(Kind kind, std::uint32_t count0, std::uint32_t count1, std::uint32_t count2,
+                             std::uint64_t version) {
+            return UInt8(static_cast<std::uint8_t>(kind)).UInt8(kFormat).UInt16(0)
+                   .UInt32(count0).UInt32(count1).UInt32(count2).UInt64(version);
+        }
+
+        BinaryWriter& UInt8(std::uint8_t value) {
+            out_ += static_cast<char>(value);
+            return *this;
+        }
+
+        BinaryWriter& UInt16(std::uint16_t value) {
+            return Append(value, sizeof(value));
+        }
+
+        BinaryWriter& UInt32(std::uint32_t value) {
+            return Append(value, sizeof(value));
+        }
+
+        BinaryWriter& UInt64(std::uint64_t value) {
+            return Append(value, sizeof(value));
+        }
+
+        BinaryWriter& Int32(std::int32_t value) {
+            return Append(static_cast<std::uint32_t>(value), sizeof(value));
+        }
+
+        // Координата или скорость в фиксированной точке
+        BinaryWriter& Coord(double value) {
+            return Int32(static_cast<std::int32_t>(std::lround(value * kCoordScale)));
+        }
+
+        BinaryWriter& Bytes(std::string_view bytes) {
+            out_ += bytes;
+            return *this;
+        }
+
+    private:
+        std::string& out_;
+
+        BinaryWriter& Append(std::uint64_t value, std::size_t size) {
+            for (std::size_t i = 0; i < size; ++i) {
+                out_ += static_cast<char>((value >> (8 * i)) & 0xFF);
+            }
+            return *this;
+        }
+    };
+}  // namespace http_handler
@@ -0,0 +1,215 @@
+#include "collision_batch.h"
+
+#include <cassert>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COLLISION_BATCH_X86
+#include <immintrin.h>
+#endif
+
+namespace collision_detector {
+
+    namespace {
+
+        using KernelFn = void (*)(const Gatherer&, size_t, const ItemsSoA&, size_t, std::vector<GatheringEvent>&);
+
+        // Обрабатывает предметы начиная с first. Этим же кодом векторные версии добирают хвост.
+        void CollectScalar(const Gatherer& gatherer, size_t gatherer_id,
+                           const ItemsSoA& items, size_t first, std::vector<GatheringEvent>& out) {
+            for (size_t i = first; i < items.Size(); ++i) {
+                TryGatherItem(gatherer, gatherer_id, items.Get(i), i, out);
+            }
+        }
+
+#ifdef COLLISION_BATCH_X86
+        // Векторные версии повторяют порядок операций TryCollectPoint, без FMA,
+        // поэтому sq_distance и proj_ratio совпадают со скалярными до бита.
+
+        __attribute__((target("avx2")))
+        void CollectAvx2(const Gatherer& gatherer, size_t gatherer_id,
+                         const ItemsSoA& items, size_t first, std::vector<GatheringEvent>& out) {
+            constexpr size_t LANES = 4;
+
+            const double v_x = gatherer.end_pos.x - gatherer.start_pos.x;
+            const double v_y = gatherer.end_pos.y - gatherer.start_pos.y;
+            const __m256d a_x = _mm256_set1_pd(gatherer.start_pos.x);
+            const __m256d a_y = _mm256_set1_pd(gatherer.start_pos.y);
+            const __m256d vv_x = _mm256_set1_pd(v_x);
+            const __m256d vv_y = _mm256_set1_pd(v_y);
+            const __m256d v_len2 = _mm256_set1_pd(v_x * v_x + v_y * v_y);
+            const __m256d g_width = _mm256_set1_pd(gatherer.width);
+            const __m256d zero = _mm256_setzero_pd();
+            const __m256d one = _mm256_set1_pd(1.0);
+
+            alignas(32) double sq_distance[LANES];
+            alignas(32) double proj_ratio[LANES];
+
+            size_t i = first;
+            for (; i + LANES <= items.Size(); i += LANES) {
+                const __m256d u_x = _mm256_sub_pd(_mm256_loadu_pd(items.X() + i), a_x);
+                const __m256d u_y = _mm256_sub_pd(_mm256_loadu_pd(items.Y() + i), a_y);
+                const __m256d u_dot_v = _mm256_add_pd(_mm256_mul_pd(u_x, vv_x), _mm256_mul_pd(u_y, vv_y));
+                const __m256d u_len2 = _mm256_add_pd(_mm256_mul_pd(u_x, u_x), _mm256_mul_pd(u_y, u_y));
+                const __m256d proj = _mm256_div_pd(u_dot_v, v_len2);
+                const __m256d sq = _mm256_sub_pd(u_len2, _mm256_div_pd(_mm256_mul_pd(u_dot_v, u_dot_v), v_len2));
+                const __m256d radius = _mm256_add_pd(g_width, _mm256_loadu_pd(items.Width() + i));
+
+                const __m256d collected = _mm256_and_pd(
+                        _mm256_and_pd(_mm256_cmp_pd(proj, zero, _CMP_GE_OQ), _mm256_cmp_pd(proj, one, _CMP_LE_OQ)),
+                        _mm256_cmp_pd(sq, _mm256_mul_pd(radius, radius), _CMP_LE_OQ));
+
+                int mask = _mm256_movemask_pd(collected);
+                if (mask == 0) {
+                    continue;
+                }
+
+                _mm256_store_pd(sq_distance, sq);
+                _mm256_store_pd(proj_ratio, proj);
+                for (size_t lane = 0; lane < LANES; ++lane) {
+                    if (mask & (1 << lane)) {
+                        out.push_back({.item_id = i + lane,
+                                       .gatherer_id = gatherer_id,
+                                       .sq_distance = sq_distance[lane],
+                                       .time = proj_ratio[lane]});
+                    }
+                }
+            }
+
+            CollectScalar(gatherer, gatherer_id, items, i, out);
+        }
+
+        __attribute__((target("sse2")))
+        void CollectSse2(const Gatherer& gatherer, size_t gatherer_id,
+                         const ItemsSoA& items, size_t first, std::vector<GatheringEvent>& out) {
+            constexpr size_t LANES = 2;
+
+            const double v_x = gatherer.end_pos.x - gatherer.start_pos.x;
+            const double v_y = gatherer.end_pos.y - gatherer.start_pos.y;
+            const __m128d a_x = _mm_set1_pd(gatherer.start_pos.x);
+            const __m128d a_y = _mm_set1_pd(gatherer.start_pos.y);
+            const __m128d vv_x = _mm_set1_pd(v_x);
+            const __m128d vv_y = _mm_set1_pd(v_y);
+            const __m128d v_len2 = _mm_set1_pd(v_x * v_x + v_y * v_y);
+            const __m128d g_width = _mm_set1_pd(gatherer.width);
+            const __m128d zero = _mm_setzero_pd();
+            const __m128d one = _mm_set1_pd(1.0);
+
+            alignas(16) double sq_distance[LANES];
+            alignas(16) double proj_ratio[LANES];
+
+            size_t i = first;
+            for (; i + LANES <= items.Size(); i += LANES) {
+                const __m128d u_x = _mm_sub_pd(_mm_loadu_pd(items.X() + i), a_x);
+                const __m128d u_y = _mm_sub_pd(_mm_loadu_pd(items.Y() + i), a_y);
+                const __m128d u_dot_v = _mm_add_pd(_mm_mul_pd(u_x, vv_x), _mm_mul_pd(u_y, vv_y));
+                const __m128d u_len2 = _mm_add_pd(_mm_mul_pd(u_x, u_x), _mm_mul_pd(u_y, u_y));
+                const __m128d proj = _mm_div_pd(u_dot_v, v_len2);
+                const __m128d sq = _mm_sub_pd(u_len2, _mm_div_pd(_mm_mul_pd(u_dot_v, u_dot_v), v_len2));
+                const __m128d radius = _mm_add_pd(g_width, _mm_loadu_pd(items.Width() + i));
+
+                const __m128d collected = _mm_and_pd(
+                        _mm_and_pd(_mm_cmpge_pd(proj, zero), _mm_cmple_pd(proj, one)),
+                        _mm_cmple_pd(sq, _mm_mul_pd(radius, radius)));
+
+                int mask = _mm_movemask_pd(collected);
+                if (mask == 0) {
+                    continue;
+                }
+
+                _mm_store_pd(sq_distance, sq);
+                _mm_store_pd(proj_ratio, proj);
+                for (size_t lane = 0; lane < LANES; ++lane) {
+                    if (mask & (1 << lane)) {
+                        out.push_back({.item_id = i + lane,
+                                       .gatherer_id = gatherer_id,
+                                       .sq_distance = sq_distance[lane],
+                                       .time = proj_ratio[lane]});
+                    }
+                }
+            }
+
+            CollectScalar(gatherer, gatherer_id, items, i, out);
+        }
+#endif
+
+        KernelFn GetKernelFn(BatchKernel kernel) {
+            switch (kernel) {
+#ifdef COLLISION_BATCH_X86
+                case BatchKernel::AVX2:
+                    return CollectAvx2;
+                case BatchKernel::SSE2:
+                    return CollectSse2;
+#else
+                case BatchKernel::AVX2:
+                case BatchKernel::SSE2:
+                    break;
+#endif
+                case BatchKernel::SCALAR:
+                    return CollectScalar;
+            }
+
+            assert(false);
+            return CollectScalar;
+        }
+
+        BatchKernel SelectKernel() {
+            for (BatchKernel kernel : {BatchKernel::AVX2, BatchKernel::SSE2}) {
+                if (IsBatchKernelSupported(kernel)) {
+                    return kernel;
+                }
+            }
+            return BatchKernel::SCALAR;
+        }
+
+        BatchKernel GetSelectedKernel() {
+            static const BatchKernel selected = SelectKernel();
+            return selected;
+        }
+
+    }  // namespace
+
+    void CollectItemsBatch(const Gatherer& gatherer, size_t gatherer_id,
+                           const ItemsSoA& items, std::vector<GatheringEvent>& out) {
+        CollectItemsBatch(gatherer, gatherer_id, items, out, GetSelectedKernel());
+    }
+
+    void CollectItemsBatch(const Gatherer& gatherer, size_t gatherer_id,
+                           const ItemsSoA& items, std::vector<GatheringEvent>& out, BatchKernel kernel) {
+        assert(!IsZeroMove(gatherer));
+        assert(IsBatchKernelSupported(kernel));
+        GetKernelFn(kernel)(gatherer, gatherer_id, items, 0, out);
+    }
+
+    bool IsBatchKernelSupported(BatchKernel kernel) {
+        switch (kernel) {
+            case BatchKernel::SCALAR:
+                return true;
+#ifdef COLLISION_BATCH_X86
+            case BatchKernel::SSE2:
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("sse2");
+            case BatchKernel::AVX2:
+                __builtin_cpu_init();
+                return __builtin_cpu_supports("avx2");
+#else
+            case BatchKernel::SSE2:
+            case BatchKernel::AVX2:
+                break;
+#endif
+        }
+        return false;
+    }
+
+    std::string_view GetBatchKernelName() {
+        switch (GetSelectedKernel()) {
+            case BatchKernel::AVX2:
+                return "avx2";
+            case BatchKernel::SSE2:
+                return "sse2";
+            case BatchKernel::SCALAR:
+                break;
+        }
+        return "scalar";
+    }
+
+}  // namespace collision_detector
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "collision_detector.h"
+
+#include <string_view>
+#include <vector>
+
+namespace collision_detector {
+
+    // Реализации пакетной проверки
+    enum class BatchKernel {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    // Проверяет отрезок сборщика со всеми предметами и добавляет в out события в порядке возрастания индекса предмета.
+    // Результат побитово совпадает с TryCollectPoint + CollectionResult::IsCollected.
+    // Реализация (AVX2, SSE2 или скалярная) выбирается один раз при запуске по возможностям процессора.
+    // Перемещение сборщика должно быть ненулевым.
+    void CollectItemsBatch(const Gatherer& gatherer, size_t gatherer_id,
+                           const ItemsSoA& items, std::vector<GatheringEvent>& out);
+
+    // То же, но заданной реализацией. Она должна поддерживаться процессором.
+    void CollectItemsBatch(const Gatherer& gatherer, size_t gatherer_id,
+                           const ItemsSoA& items, std::vector<GatheringEvent>& out, BatchKernel kernel);
+
+    bool IsBatchKernelSupported(BatchKernel kernel);
+
+    // Название реализации, выбранной при запуске: "avx2", "sse2" или "scalar"
+    std::string_view GetBatchKernelName();
+
+}  // namespace collision_detector
@@ -1,60 +1,105 @@
 #include "collision_detector.h"
 #include <cassert>
+#include <cmath>
+#include <tuple>
 
 namespace collision_detector {
 
-    CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D c) {
-        // Проверим, что перемещение ненулевое.
-        // Тут приходится использовать строгое равенство, а не приближённое,
-        // пскольку при сборе заказов придётся учитывать перемещение даже на небольшое
-        // расстояние.
-        assert(b.x != a.x || b.y != a.y);
-        const double u_x = c.x - a.x;
-        const double u_y = c.y - a.y;
-        const double v_x = b.x - a.x;
-        const double v_y = b.y - a.y;
-        const double u_dot_v = u_x * v_x + u_y * v_y;
-        const double u_len2 = u_x * u_x + u_y * u_y;
-        const double v_len2 = v_x * v_x + v_y * v_y;
-        const double proj_ratio = u_dot_v / v_len2;
-        const double sq_distance = u_len2 - (u_dot_v * u_dot_v) / v_len2;
-
-        return CollectionResult{sq_distance, proj_ratio};
+    void SortGatheringEvents(std::vector<GatheringEvent>& detected_events) {
+        std::sort(detected_events.begin(), detected_events.end(),
+                  [](const GatheringEvent& e_l, const GatheringEvent& e_r) {
+                      return std::tie(e_l.time, e_l.gatherer_id, e_l.item_id)
+                             < std::tie(e_r.time, e_r.gatherer_id, e_r.item_id);
+                  });
     }
 
-    std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider) {
-        std::vector<GatheringEvent> detected_events;
-
-        static auto eq_pt = [](geom::Point2D p1, geom::Point2D p2) {
-            return p1.x == p2.x && p1.y == p2.y;
-        };
-
-        for (size_t g = 0; g < provider.GatherersCount(); ++g) {
-            Gatherer gatherer = provider.GetGatherer(g);
-            if (eq_pt(gatherer.start_pos, gatherer.end_pos)) {
-                continue;
-            }
-            for (size_t i = 0; i < provider.ItemsCount(); ++i) {
-                Item item = provider.GetItem(i);
-                auto collect_result
-                        = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position);
-
-                if (collect_result.IsCollected(gatherer.width + item.width)) {
-                    GatheringEvent evt{.item_id = i,
-                            .gatherer_id = g,
-                            .sq_distance = collect_result.sq_distance,
-                            .time = collect_result.proj_ratio};
-                    detected_events.push_back(evt);
-                }
-            }
+    void ItemsSoA::PushBack(const Item& item) {
+        x_.push_back(item.position.x);
+        y_.push_back(item.position.y);
+        width_.push_back(item.width);
+    }
+
+    void ItemsSoA::SwapRemove(size_t idx) {
+        x_[idx] = x_.back();
+        y_[idx] = y_.back();
+        width_[idx] = width_.back();
+        x_.pop_back();
+        y_.pop_back();
+        width_.pop_back();
+    }
+
+    void ItemGrid::Insert(size_t item_id, const Item& item) {
+        max_item_width_ = std::max(max_item_width_, item.width);
+        Cell& cell = cells_[GetItemCellKey(item)];
+        cell.items.PushBack(item);
+        cell.ids.push_back(item_id);
+    }
+
+    void ItemGrid::Erase(size_t item_id, const Item& item) {
+        auto cell_it = cells_.find(GetItemCellKey(item));
+        assert(cell_it != cells_.end());
+        auto& cell = cell_it->second;
+        auto it = std::find(cell.ids.begin(), cell.ids.end(), item_id);
+        assert(it != cell.ids.end());
+        // Порядок внутри ячейки не важен, события всё равно сортируются
+        const size_t idx = it - cell.ids.begin();
+        cell.items.SwapRemove(idx);
+        cell.ids[idx] = cell.ids.back();
+        cell.ids.pop_back();
+
+        // Пустая ячейка удаляется: иначе за долгую сессию словарь только растёт,
+        // а ForEachCandidateCell выбирает способ обхода по числу заполненных ячеек
+        if (cell.ids.empty()) {
+            cells_.erase(cell_it);
         }
+    }
 
-        std::sort(detected_events.begin(), detected_events.end(),
-                  [](const GatheringEvent& e_l, const GatheringEvent& e_r) {
-                      return e_l.time < e_r.time;
-                  });
+    void ItemGrid::Renumber(size_t old_id, size_t new_id, const Item& item) {
+        auto cell_it = cells_.find(GetItemCellKey(item));
+        assert(cell_it != cells_.end());
+        auto& ids = cell_it->second.ids;
+        auto it = std::find(ids.begin(), ids.end(), old_id);
+        assert(it != ids.end());
+        *it = new_id;
+    }
+
+    void ItemGrid::GetCandidates(const Gatherer& gatherer, std::vector<size_t>& out) const {
+        out.clear();
+        ForEachCandidateCell(gatherer, [&out](const Cell& cell) {
+            out.insert(out.end(), cell.ids.begin(), cell.ids.end());
+        });
+        std::sort(out.begin(), out.end());
+    }
+
+    ItemGrid::CellRange ItemGrid::GetCellRange(const Gatherer& gatherer) const {
+        // Запас на погрешность вычисления квадрата расстояния в TryCollectPoint
+        constexpr double MARGIN = 1e-6;
+        const double reach = gatherer.width + max_item_width_ + MARGIN;
+
+        return {GetCellCoord(std::min(gatherer.start_pos.x, gatherer.end_pos.x) - reach),
+                GetCellCoord(std::max(gatherer.start_pos.x, gatherer.end_pos.x) + reach),
+                GetCellCoord(std::min(gatherer.start_pos.y, gatherer.end_pos.y) - reach),
+                GetCellCoord(std::max(gatherer.start_pos.y, gatherer.end_pos.y) + reach)};
+    }
+
+    int64_t ItemGrid::GetCellCoord(double coord) const {
+        return static_cast<int64_t>(std::floor(coord / cell_size_));
+    }
+
+    ItemGrid::CellKey ItemGrid::GetItemCellKey(const Item& item) const {
+        return GetCellKey(GetCellCoord(item.position.x), GetCellCoord(item.position.y));
+    }
+
+    ItemGrid::CellKey ItemGrid::GetCellKey(int64_t x, int64_t y) {
+        return (static_cast<CellKey>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    }
+
+    std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider) {
+        return FindGatherEvents<ItemGathererProvider>(provider, Engine::BRUTE_FORCE);
+    }
 
-        return detected_events;
+    std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider, Engine engine) {
+        return FindGatherEvents<ItemGathererProvider>(provider, engine);
     }
 
 }  // namespace collision_detector
\ No newline at end of file
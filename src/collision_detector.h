@@ -1,8 +1,15 @@
 #pragma once
 
 #include "geom.h"
+#include "worker_pool.h"
 
 #include <algorithm>
+#include <cassert>
+#include <concepts>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <unordered_map>
 #include <vector>
 
 namespace collision_detector {
@@ -21,7 +28,25 @@ namespace collision_detector {
 
 // Движемся из точки a в точку b и пытаемся подобрать точку c.
 // Эта функция реализована в уроке.
-    CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D c);
+// Определена в заголовке, чтобы компилятор мог встроить её во внутренний цикл FindGatherEvents.
+    inline CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D c) {
+        // Проверим, что перемещение ненулевое.
+        // Тут приходится использовать строгое равенство, а не приближённое,
+        // пскольку при сборе заказов придётся учитывать перемещение даже на небольшое
+        // расстояние.
+        assert(b.x != a.x || b.y != a.y);
+        const double u_x = c.x - a.x;
+        const double u_y = c.y - a.y;
+        const double v_x = b.x - a.x;
+        const double v_y = b.y - a.y;
+        const double u_dot_v = u_x * v_x + u_y * v_y;
+        const double u_len2 = u_x * u_x + u_y * u_y;
+        const double v_len2 = v_x * v_x + v_y * v_y;
+        const double proj_ratio = u_dot_v / v_len2;
+        const double sq_distance = u_len2 - (u_dot_v * u_dot_v) / v_len2;
+
+        return CollectionResult{sq_distance, proj_ratio};
+    }
 
     struct Item {
         geom::Point2D position;
@@ -34,6 +59,8 @@ namespace collision_detector {
         double width;
     };
 
+    // Виртуальный интерфейс оставлен как адаптер для внешнего кода.
+    // Внутри FindGatherEvents работает с любым типом, удовлетворяющим концепту ItemGathererProviderLike.
     class ItemGathererProvider {
     protected:
         ~ItemGathererProvider() = default;
@@ -45,7 +72,7 @@ namespace collision_detector {
         virtual Gatherer GetGatherer(size_t idx) const = 0;
     };
 
-    class VectorItemGathererProvider : public collision_detector::ItemGathererProvider {
+    class VectorItemGathererProvider final : public collision_detector::ItemGathererProvider {
     public:
         VectorItemGathererProvider(const std::vector<collision_detector::Item>& items,
                                    const std::vector<collision_detector::Gatherer>& gatherers)
@@ -78,6 +105,42 @@ namespace collision_detector {
         std::vector<collision_detector::Gatherer> gatherers_;
     };
 
+    // Поставщик предметов и сборщиков, тип которого известен на этапе компиляции.
+    // Вызовы его методов встраиваются, а возврат по ссылке избавляет от копирования.
+    template <typename Provider>
+    concept ItemGathererProviderLike = requires(const Provider& provider, size_t idx) {
+        { provider.ItemsCount() } -> std::convertible_to<size_t>;
+        { provider.GetItem(idx) } -> std::convertible_to<Item>;
+        { provider.GatherersCount() } -> std::convertible_to<size_t>;
+        { provider.GetGatherer(idx) } -> std::convertible_to<Gatherer>;
+    };
+
+    // Не владеет данными, только ссылается на них
+    class SpanItemGathererProvider {
+    public:
+        SpanItemGathererProvider(std::span<const Item> items, std::span<const Gatherer> gatherers) noexcept
+                : items_(items)
+                , gatherers_(gatherers) {
+        }
+
+        size_t ItemsCount() const noexcept {
+            return items_.size();
+        }
+        const Item& GetItem(size_t idx) const noexcept {
+            return items_[idx];
+        }
+        size_t GatherersCount() const noexcept {
+            return gatherers_.size();
+        }
+        const Gatherer& GetGatherer(size_t idx) const noexcept {
+            return gatherers_[idx];
+        }
+
+    private:
+        std::span<const Item> items_;
+        std::span<const Gatherer> gatherers_;
+    };
+
     struct GatheringEvent {
         size_t item_id;
         size_t gatherer_id;
@@ -85,8 +148,294 @@ namespace collision_detector {
         double time;
     };
 
+    inline bool IsZeroMove(const Gatherer& gatherer) {
+        return gatherer.start_pos.x == gatherer.end_pos.x && gatherer.start_pos.y == gatherer.end_pos.y;
+    }
+
+    // Добавляет событие в detected_events, если сборщик подбирает предмет
+    inline void TryGatherItem(const Gatherer& gatherer, size_t gatherer_id,
+                              const Item& item, size_t item_id,
+                              std::vector<GatheringEvent>& detected_events) {
+        auto collect_result
+                = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position);
+
+        if (collect_result.IsCollected(gatherer.width + item.width)) {
+            GatheringEvent evt{.item_id = item_id,
+                    .gatherer_id = gatherer_id,
+                    .sq_distance = collect_result.sq_distance,
+                    .time = collect_result.proj_ratio};
+            detected_events.push_back(evt);
+        }
+    }
+
+    // Упорядочивает события по времени, одновременные - по сборщику и предмету.
+    // Порядок не зависит от порядка событий на входе, поэтому параллельный поиск даёт тот же результат.
+    void SortGatheringEvents(std::vector<GatheringEvent>& detected_events);
+
+    // Способ поиска событий сбора
+    enum class Engine {
+        // Каждый сборщик проверяется с каждым предметом
+        BRUTE_FORCE,
+        // Сборщик проверяется только с предметами из ячеек равномерной сетки, которые задевает его отрезок
+        UNIFORM_GRID
+    };
+
+    // Позиции и ширины предметов в виде структуры массивов, чтобы их можно было читать векторными инструкциями
+    class ItemsSoA {
+    public:
+        size_t Size() const noexcept {
+            return x_.size();
+        }
+
+        Item Get(size_t idx) const {
+            return {{x_[idx], y_[idx]}, width_[idx]};
+        }
+
+        void PushBack(const Item& item);
+
+        // На место удалённого предмета переезжает последний
+        void SwapRemove(size_t idx);
+
+        const double* X() const noexcept {
+            return x_.data();
+        }
+
+        const double* Y() const noexcept {
+            return y_.data();
+        }
+
+        const double* Width() const noexcept {
+            return width_.data();
+        }
+
+    private:
+        std::vector<double> x_;
+        std::vector<double> y_;
+        std::vector<double> width_;
+    };
+
+    // Равномерная сетка предметов. Каждый предмет лежит ровно в одной ячейке - той, в которую попадает его центр.
+    class ItemGrid {
+    public:
+        constexpr static double DEFAULT_CELL_SIZE = 2.0;
+
+        // Предметы ячейки подряд, чтобы их можно было проверить пакетно, и их индексы в том же порядке
+        struct Cell {
+            ItemsSoA items;
+            std::vector<size_t> ids;
+        };
+
+        explicit ItemGrid(double cell_size = DEFAULT_CELL_SIZE)
+                : cell_size_(cell_size) {
+        }
+
+        void Insert(size_t item_id, const Item& item);
+
+        void Erase(size_t item_id, const Item& item);
+
+        // Предмет item сменил индекс с old_id на new_id
+        void Renumber(size_t old_id, size_t new_id, const Item& item);
+
+        // Записывает в out индексы предметов (по возрастанию), которые может подобрать сборщик.
+        // Лишние кандидаты допустимы, пропущенных быть не может.
+        void GetCandidates(const Gatherer& gatherer, std::vector<size_t>& out) const;
+
+        // Вызывает fn(const Cell&) для каждой непустой ячейки, предметы которой может подобрать сборщик.
+        // Ячейки перебираются в произвольном порядке
+        template <typename Fn>
+        void ForEachCandidateCell(const Gatherer& gatherer, Fn&& fn) const {
+            const CellRange range = GetCellRange(gatherer);
+            const uint64_t cells_in_box = static_cast<uint64_t>(range.max_x - range.min_x + 1)
+                                          * static_cast<uint64_t>(range.max_y - range.min_y + 1);
+            if (cells_in_box > cells_.size()) {
+                // Отрезок задевает больше ячеек, чем заполнено в сетке. Дешевле пройти по заполненным.
+                for (const auto& [key, cell] : cells_) {
+                    const auto x = static_cast<int64_t>(static_cast<int32_t>(key >> 32));
+                    const auto y = static_cast<int64_t>(static_cast<int32_t>(key & 0xFFFFFFFFu));
+                    if (x >= range.min_x && x <= range.max_x && y >= range.min_y && y <= range.max_y) {
+                        fn(cell);
+                    }
+                }
+            } else {
+                for (int64_t x = range.min_x; x <= range.max_x; ++x) {
+                    for (int64_t y = range.min_y; y <= range.max_y; ++y) {
+                        if (auto it = cells_.find(GetCellKey(x, y)); it != cells_.end()) {
+                            fn(it->second);
+                        }
+                    }
+                }
+            }
+        }
+
+    private:
+        using CellKey = uint64_t;
+
+        struct CellRange {
+            int64_t min_x;
+            int64_t max_x;
+            int64_t min_y;
+            int64_t max_y;
+        };
+
+        double cell_size_;
+        // Наибольшая ширина предмета в сетке, на неё расширяется область поиска вокруг отрезка
+        double max_item_width_ = 0.;
+        std::unordered_map<CellKey, Cell> cells_;
+
+        // Ячейки, в которых могут лежать предметы, доступные сборщику
+        CellRange GetCellRange(const Gatherer& gatherer) const;
+
+        int64_t GetCellCoord(double coord) const;
+
+        CellKey GetItemCellKey(const Item& item) const;
+
+        static CellKey GetCellKey(int64_t x, int64_t y);
+    };
+
+    // Параметры параллельного поиска событий
+    struct ParallelOptions {
+        constexpr static size_t DEFAULT_WORK_THRESHOLD = 1u << 16;
+        // Для сетки число проверок на одного сборщика заранее неизвестно, берём оценку
+        constexpr static size_t GRID_CHECKS_PER_GATHERER = 8;
+
+        // Без пула поиск всегда идёт в вызывающем потоке
+        util::WorkerPool* pool = nullptr;
+        // Оценка работы - число проверок пар сборщик-предмет. Ниже порога поиск идёт в одном потоке.
+        size_t work_threshold = DEFAULT_WORK_THRESHOLD;
+
+        bool IsParallel(Engine engine, size_t gatherers_count, size_t items_count) const noexcept {
+            if (!pool || pool->GetThreadCount() < 2) {
+                return false;
+            }
+            const size_t checks_per_gatherer = (engine == Engine::UNIFORM_GRID) ? GRID_CHECKS_PER_GATHERER : items_count;
+            return gatherers_count * checks_per_gatherer >= work_threshold;
+        }
+    };
+
+    namespace detail {
+
+        // Проверяет сборщиков с индексами [first_gatherer, last_gatherer), события не сортирует
+        template <ItemGathererProviderLike Provider>
+        void FindGatherEventsBruteForce(const Provider& provider,
+                                        size_t first_gatherer, size_t last_gatherer,
+                                        std::vector<GatheringEvent>& detected_events) {
+            const size_t items_count = provider.ItemsCount();
+            for (size_t g = first_gatherer; g < last_gatherer; ++g) {
+                const Gatherer gatherer = provider.GetGatherer(g);
+                if (IsZeroMove(gatherer)) {
+                    continue;
+                }
+                for (size_t i = 0; i < items_count; ++i) {
+                    TryGatherItem(gatherer, g, provider.GetItem(i), i, detected_events);
+                }
+            }
+        }
+
+        template <ItemGathererProviderLike Provider>
+        void FindGatherEventsUniformGrid(const Provider& provider, const ItemGrid& grid,
+                                         size_t first_gatherer, size_t last_gatherer,
+                                         std::vector<size_t>& candidates,
+                                         std::vector<GatheringEvent>& detected_events) {
+            for (size_t g = first_gatherer; g < last_gatherer; ++g) {
+                const Gatherer gatherer = provider.GetGatherer(g);
+                if (IsZeroMove(gatherer)) {
+                    continue;
+                }
+                grid.GetCandidates(gatherer, candidates);
+                for (size_t i : candidates) {
+                    TryGatherItem(gatherer, g, provider.GetItem(i), i, detected_events);
+                }
+            }
+        }
+
+        // Собирает события сборщиков [first_gatherer, last_gatherer). grid нужна только для Engine::UNIFORM_GRID.
+        template <ItemGathererProviderLike Provider>
+        void FindGatherEvents(const Provider& provider, Engine engine, const ItemGrid* grid,
+                              size_t first_gatherer, size_t last_gatherer,
+                              std::vector<size_t>& candidates,
+                              std::vector<GatheringEvent>& detected_events) {
+            switch (engine) {
+                case Engine::UNIFORM_GRID:
+                    FindGatherEventsUniformGrid(provider, *grid, first_gatherer, last_gatherer,
+                                                candidates, detected_events);
+                    break;
+                case Engine::BRUTE_FORCE:
+                    FindGatherEventsBruteForce(provider, first_gatherer, last_gatherer, detected_events);
+                    break;
+            }
+        }
+
+        // Сборщики делятся между потоками пула, у каждой части свой буфер событий.
+        // find_range(first_gatherer, last_gatherer, candidates, events) ищет события части.
+        // Буферы склеиваются в порядке частей, поэтому до сортировки порядок событий тот же, что в одном потоке.
+        template <typename FindRange>
+        void FindGatherEventsParallel(util::WorkerPool& pool, size_t gatherers_count, const FindRange& find_range,
+                                      std::vector<std::vector<size_t>>& part_candidates,
+                                      std::vector<std::vector<GatheringEvent>>& part_events,
+                                      std::vector<GatheringEvent>& detected_events) {
+            const size_t parts_count = pool.GetPartsCount(gatherers_count);
+            part_candidates.resize(std::max(part_candidates.size(), parts_count));
+            part_events.resize(std::max(part_events.size(), parts_count));
+
+            pool.ParallelFor(gatherers_count, [&](size_t begin, size_t end, size_t part) {
+                part_events[part].clear();
+                find_range(begin, end, part_candidates[part], part_events[part]);
+            });
+
+            for (size_t part = 0; part < parts_count; ++part) {
+                detected_events.insert(detected_events.end(), part_events[part].begin(), part_events[part].end());
+            }
+        }
+
+    }  // namespace detail
+
+    // Результат всегда совпадает с результатом полного перебора в одном потоке, отличается только скорость
+    template <ItemGathererProviderLike Provider>
+    std::vector<GatheringEvent> FindGatherEvents(const Provider& provider,
+                                                 Engine engine = Engine::BRUTE_FORCE,
+                                                 const ParallelOptions& parallel = {}) {
+        std::vector<GatheringEvent> detected_events;
+
+        std::optional<ItemGrid> grid;
+        if (engine == Engine::UNIFORM_GRID) {
+            grid.emplace();
+            for (size_t i = 0; i < provider.ItemsCount(); ++i) {
+                grid->Insert(i, provider.GetItem(i));
+            }
+        }
+        const ItemGrid* grid_ptr = grid ? &*grid : nullptr;
+
+        if (parallel.IsParallel(engine, provider.GatherersCount(), provider.ItemsCount())) {
+            std::vector<std::vector<size_t>> part_candidates;
+            std::vector<std::vector<GatheringEvent>> part_events;
+            auto find_range = [&](size_t first_gatherer, size_t last_gatherer,
+                                  std::vector<size_t>& candidates, std::vector<GatheringEvent>& events) {
+                detail::FindGatherEvents(provider, engine, grid_ptr, first_gatherer, last_gatherer, candidates, events);
+            };
+            detail::FindGatherEventsParallel(*parallel.pool, provider.GatherersCount(), find_range,
+                                             part_candidates, part_events, detected_events);
+        } else {
+            std::vector<size_t> candidates;
+            detail::FindGatherEvents(provider, engine, grid_ptr, 0, provider.GatherersCount(),
+                                     candidates, detected_events);
+        }
+
+        SortGatheringEvents(detected_events);
+
+        return detected_events;
+    }
+
+    inline std::vector<GatheringEvent> FindGatherEvents(std::span<const Item> items,
+                                                        std::span<const Gatherer> gatherers,
+                                                        Engine engine = Engine::BRUTE_FORCE) {
+        return FindGatherEvents(SpanItemGathererProvider{items, gatherers}, engine);
+    }
+
 // Эту функцию вам нужно будет реализовать в соответствующем задании.
 // При проверке ваших тестов она не нужна - функция будет линковаться снаружи.
+// Перегрузки для виртуального интерфейса - адаптеры над шаблонной версией.
     std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider);
 
+    std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider, Engine engine);
+
 }  // namespace collision_detector
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "collision_world.h"
+
+namespace collision_detector {
+
+    size_t CollisionWorld::AddItem(const Item& item) {
+        const size_t idx = items_.Size();
+        items_.PushBack(item);
+        if (engine_ == Engine::UNIFORM_GRID) {
+            grid_.Insert(idx, item);
+        }
+        return idx;
+    }
+
+    size_t CollisionWorld::RemoveItem(size_t idx) {
+        const size_t last = items_.Size() - 1;
+        if (engine_ == Engine::UNIFORM_GRID) {
+            grid_.Erase(idx, items_.Get(idx));
+            if (idx != last) {
+                grid_.Renumber(last, idx, items_.Get(last));
+            }
+        }
+        items_.SwapRemove(idx);
+        return last;
+    }
+
+    size_t CollisionWorld::AddGatherer(const Gatherer& gatherer) {
+        gatherers_.push_back(gatherer);
+        return gatherers_.size() - 1;
+    }
+
+    const std::vector<GatheringEvent>& CollisionWorld::FindGatherEvents() {
+        events_.clear();
+
+        if (parallel_.IsParallel(engine_, gatherers_.size(), items_.Size())) {
+            // Кандидатов по одному мир не выписывает: ячейки сетки проверяются целиком
+            auto find_range = [this](size_t first_gatherer, size_t last_gatherer,
+                                     std::vector<size_t>&, std::vector<GatheringEvent>& events) {
+                FindGatherEvents(first_gatherer, last_gatherer, events);
+            };
+            detail::FindGatherEventsParallel(*parallel_.pool, gatherers_.size(), find_range,
+                                             part_candidates_, part_events_, events_);
+        } else {
+            FindGatherEvents(0, gatherers_.size(), events_);
+        }
+
+        SortGatheringEvents(events_);
+
+        return events_;
+    }
+
+    void CollisionWorld::FindGatherEvents(size_t first_gatherer, size_t last_gatherer,
+                                          std::vector<GatheringEvent>& detected_events) const {
+        for (size_t g = first_gatherer; g < last_gatherer; ++g) {
+            const Gatherer& gatherer = gatherers_[g];
+            if (IsZeroMove(gatherer)) {
+                continue;
+            }
+
+            switch (engine_) {
+                case Engine::UNIFORM_GRID:
+                    grid_.ForEachCandidateCell(gatherer, [&](const ItemGrid::Cell& cell) {
+                        const size_t first_event = detected_events.size();
+                        CollectItemsBatch(gatherer, g, cell.items, detected_events);
+                        // Пакетная проверка нумерует предметы внутри ячейки, переводим в индексы мира
+                        for (size_t e = first_event; e < detected_events.size(); ++e) {
+                            detected_events[e].item_id = cell.ids[detected_events[e].item_id];
+                        }
+                    });
+                    break;
+                case Engine::BRUTE_FORCE:
+                    CollectItemsBatch(gatherer, g, items_, detected_events);
+                    break;
+            }
+        }
+    }
+
+}  // namespace collision_detector
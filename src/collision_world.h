@@ -0,0 +1,70 @@
+#pragma once
+
+#include "collision_detector.h"
+#include "collision_batch.h"
+
+#include <vector>
+
+namespace collision_detector {
+
+    // Предметы и сборщики, которые хранятся между вызовами FindGatherEvents.
+    // Сетка предметов обновляется по мере добавления и удаления предметов, а буферы переиспользуются,
+    // поэтому поиск событий без изменений в наборе предметов не выделяет память.
+    class CollisionWorld final : public ItemGathererProvider {
+    public:
+        explicit CollisionWorld(Engine engine = Engine::BRUTE_FORCE, ParallelOptions parallel = {})
+                : engine_(engine)
+                , parallel_(parallel) {
+        }
+
+        size_t ItemsCount() const override {
+            return items_.Size();
+        }
+        Item GetItem(size_t idx) const override {
+            return items_.Get(idx);
+        }
+        size_t GatherersCount() const override {
+            return gatherers_.size();
+        }
+        Gatherer GetGatherer(size_t idx) const override {
+            return gatherers_[idx];
+        }
+
+        // Возвращает индекс добавленного предмета
+        size_t AddItem(const Item& item);
+
+        // На место удалённого предмета переезжает последний.
+        // Возвращает прежний индекс переехавшего предмета (совпадает с idx, если удалён последний).
+        size_t RemoveItem(size_t idx);
+
+        // Возвращает индекс добавленного сборщика. Индексы сборщиков не меняются.
+        size_t AddGatherer(const Gatherer& gatherer);
+
+        void SetGatherer(size_t idx, const Gatherer& gatherer) {
+            gatherers_[idx] = gatherer;
+        }
+
+        // Ссылка действительна до следующего вызова FindGatherEvents
+        const std::vector<GatheringEvent>& FindGatherEvents();
+
+    private:
+        Engine engine_;
+        ParallelOptions parallel_;
+
+        ItemsSoA items_;
+        std::vector<Gatherer> gatherers_;
+
+        // Заполняется только для Engine::UNIFORM_GRID
+        ItemGrid grid_;
+
+        std::vector<GatheringEvent> events_;
+
+        // Буферы частей для параллельного поиска
+        std::vector<std::vector<size_t>> part_candidates_;
+        std::vector<std::vector<GatheringEvent>> part_events_;
+
+        void FindGatherEvents(size_t first_gatherer, size_t last_gatherer,
+                              std::vector<GatheringEvent>& detected_events) const;
+    };
+
+}  // namespace collision_detector
@@ -0,0 +1,175 @@
+#include "compression.h"
+
+#include "http_handler_string_constants.h"
+
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <boost/crc.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
+
+namespace http_handler {
+    using namespace std::literals;
+
+    namespace {
+        namespace zlib = beast::zlib;
+
+        // Заголовок gzip: метод deflate, без имени файла и времени изменения, ОС не указана
+        constexpr std::array<char, 10> kGzipHeader{'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff'};
+        // Контрольная сумма CRC-32 и длина исходных данных
+        constexpr std::size_t kGzipTrailerSize = 8;
+
+        void AppendUInt32(std::string& out, std::uint32_t value) {
+            for (int i = 0; i < 4; ++i) {
+                out += static_cast<char>((value >> (8 * i)) & 0xFF);
+            }
+        }
+
+        bool IsEqualIgnoreCase(std::string_view lhs, std::string_view rhs) {
+            return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](char l, char r) {
+                return std::tolower(static_cast<unsigned char>(l)) == std::tolower(static_cast<unsigned char>(r));
+            });
+        }
+
+        std::string_view Trim(std::string_view value) {
+            auto begin = value.find_first_not_of(' ');
+            if (begin == std::string_view::npos) {
+                return {};
+            }
+            return value.substr(begin, value.find_last_not_of(' ') - begin + 1);
+        }
+
+        bool HasBody(http::status status) {
+            return status != http::status::not_modified && status != http::status::no_content;
+        }
+
+        // Нужно ли сжимать тело ответа. Vary ставится на все ответы, которые могли бы быть сжаты,
+        // чтобы кэши не отдали несжатую копию клиенту, ждущему gzip, и наоборот
+        template <typename Body>
+        bool PrepareCompression(http::response<Body>& response, std::size_t body_size,
+                                std::string_view accept_encoding, const CompressionOptions& options) {
+            if (!options.IsEnabled() || !HasBody(response.result())
+                || response.count(http::field::content_encoding)
+                || !IsCompressible(response[http::field::content_type])) {
+                return false;
+            }
+            AddVary(response, "Accept-Encoding"sv);
+            return body_size >= options.min_dynamic_size && IsGzipAccepted(accept_encoding);
+        }
+    }  // namespace
+
+    std::string GzipCompress(std::string_view data, int level) {
+        zlib::deflate_stream stream;
+        stream.reset(level, 15, 8, zlib::Strategy::normal);
+
+        // Буфера размера upper_bound хватает, чтобы сжать данные за один вызов
+        std::string out(kGzipHeader.size() + stream.upper_bound(data.size()), '\0');
+        std::copy(kGzipHeader.begin(), kGzipHeader.end(), out.begin());
+
+        zlib::z_params params;
+        params.next_in = data.data();
+        params.avail_in = data.size();
+        params.next_out = out.data() + kGzipHeader.size();
+        params.avail_out = out.size() - kGzipHeader.size();
+
+        beast::error_code ec;
+        stream.write(params, zlib::Flush::finish, ec);
+        // end_of_stream означает, что все данные сжаты и записаны
+        if (ec != zlib::error::end_of_stream) {
+            throw std::runtime_error("Failed to compress response body: "s + ec.message());
+        }
+        out.resize(kGzipHeader.size() + params.total_out);
+
+        boost::crc_32_type crc;
+        crc.process_bytes(data.data(), data.size());
+        out.reserve(out.size() + kGzipTrailerSize);
+        AppendUInt32(out, crc.checksum());
+        AppendUInt32(out, static_cast<std::uint32_t>(data.size()));
+
+        return out;
+    }
+
+    SharedBody::value_type MakeGzipBody(std::string_view body, const CompressionOptions& options) {
+        if (!options.IsEnabled()) {
+            return nullptr;
+        }
+        auto compressed = GzipCompress(body, options.level);
+        if (compressed.size() >= body.size()) {
+            return nullptr;
+        }
+        return std::make_shared<const std::string>(std::move(compressed));
+    }
+
+    bool IsGzipAccepted(std::string_view accept_encoding) {
+        // Явно указанная кодировка важнее "*": при "gzip;q=0, *" gzip запрещён, поэтому сначала просматриваем
+        // весь заголовок. gzip и x-gzip - одна и та же кодировка
+        bool gzip_listed = false;
+        bool gzip_accepted = false;
+        bool any_accepted = false;
+
+        while (!accept_encoding.empty()) {
+            auto coding = accept_encoding.substr(0, accept_encoding.find(','));
+            accept_encoding.remove_prefix(std::min(coding.size() + 1, accept_encoding.size()));
+
+            // Кодировка с весом q=0 клиентом явно запрещена
+            auto semicolon = coding.find(';');
+            auto name = Trim(coding.substr(0, semicolon));
+            bool refused = false;
+            if (semicolon != std::string_view::npos) {
+                auto weight = Trim(coding.substr(semicolon + 1));
+                refused = weight.substr(0, 2) == "q="sv && weight.substr(2).find_first_not_of("0."sv) == std::string_view::npos;
+            }
+
+            if (IsEqualIgnoreCase(name, "gzip"sv) || IsEqualIgnoreCase(name, "x-gzip"sv)) {
+                gzip_listed = true;
+                gzip_accepted = gzip_accepted || !refused;
+            } else if (name == "*"sv) {
+                any_accepted = any_accepted || !refused;
+            }
+        }
+
+        return gzip_accepted || (!gzip_listed && any_accepted);
+    }
+
+    bool IsCompressible(std::string_view content_type) {
+        content_type = content_type.substr(0, content_type.find(';'));
+        return content_type.substr(0, 5) == "text/"sv
+               || content_type == ContentType::APPLICATION_JSON
+               || content_type == ContentType::IMAGE_SVG
+               || content_type == "application/javascript"sv;
+    }
+
+    void CompressResponse(StringResponse& response, std::string_view accept_encoding, const CompressionOptions& options) {
+        if (!PrepareCompression(response, response.body().size(), accept_encoding, options)) {
+            return;
+        }
+
+        auto compressed = GzipCompress(response.body(), options.level);
+        if (compressed.size() >= response.body().size()) {
+            return;
+        }
+        response.body() = std::move(compressed);
+        response.content_length(response.body().size());
+        MarkGzipEncoded(response);
+    }
+
+    void CompressResponse(SharedResponse& response, std::string_view accept_encoding, const CompressionOptions& options) {
+        if (!response.body()
+            || !PrepareCompression(response, response.body()->size(), accept_encoding, options)) {
+            return;
+        }
+
+        // Разделяемое тело не меняется: сжатая копия принадлежит только этому ответу
+        auto compressed = MakeGzipBody(*response.body(), options);
+        if (!compressed) {
+            return;
+        }
+        response.content_length(compressed->size());
+        response.body() = std::move(compressed);
+        MarkGzipEncoded(response);
+    }
+
+}  // namespace http_handler
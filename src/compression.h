@@ -0,0 +1,65 @@
+#pragma once
+
+#include "response_maker.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace http_handler {
+
+    // Параметры сжатия тел ответов в gzip
+    struct CompressionOptions {
+        // Уровень сжатия от 1 (быстрее) до 9 (меньше); 0 отключает сжатие
+        int level = 6;
+        // Тела, которые собираются для каждого запроса, сжимаются только начиная с этого размера:
+        // на коротких телах сжатие почти ничего не выигрывает, но тратит время потока
+        std::size_t min_dynamic_size = 1024;
+
+        bool IsEnabled() const {
+            return level > 0;
+        }
+    };
+
+    // Сжимает данные в формат gzip (RFC 1952)
+    std::string GzipCompress(std::string_view data, int level);
+
+    // Сжатая копия тела, которую можно хранить и отдавать многим клиентам.
+    // nullptr, если сжатие отключено или не уменьшает тело
+    SharedBody::value_type MakeGzipBody(std::string_view body, const CompressionOptions& options);
+
+    // Принимает ли клиент ответы в gzip по заголовку Accept-Encoding
+    bool IsGzipAccepted(std::string_view accept_encoding);
+
+    // Имеет ли смысл сжимать тело такого типа. Изображения PNG и двоичные форматы уже плотные
+    bool IsCompressible(std::string_view content_type);
+
+    // Добавляет в заголовок Vary ещё одно поле запроса, от которого зависит ответ
+    template <typename Body>
+    void AddVary(http::response<Body>& response, std::string_view field) {
+        auto vary = response[http::field::vary];
+        if (vary.empty()) {
+            response.set(http::field::vary, field);
+        } else if (vary.find(field) == std::string_view::npos) {
+            response.set(http::field::vary, std::string{vary} + ", " + std::string{field});
+        }
+    }
+
+    // Помечает ответ со сжатым телом. Сжатое представление отличается от исходного побайтно,
+    // поэтому его ETag становится слабым: If-None-Match сравнивает теги без учёта W/
+    template <typename Body>
+    void MarkGzipEncoded(http::response<Body>& response) {
+        response.set(http::field::content_encoding, "gzip");
+        AddVary(response, "Accept-Encoding");
+        if (auto etag = response[http::field::etag]; !etag.empty() && etag.substr(0, 2) != "W/") {
+            response.set(http::field::etag, "W/" + std::string{etag});
+        }
+    }
+
+    // Сжимает тело собранного для запроса ответа, если клиент принимает gzip, тип тела сжимаемый
+    // и тело не короче порога. Ответы, уже сжатые заранее, не трогает
+    void CompressResponse(StringResponse& response, std::string_view accept_encoding, const CompressionOptions& options);
+
+    void CompressResponse(SharedResponse& response, std::string_view accept_encoding, const CompressionOptions& options);
+
+}  // namespace http_handler
@@ -54,6 +54,10 @@ namespace model {
         constexpr static StrType scale{"scale"};
 
         constexpr static StrType lostObjects{"lostObjects"};
+        constexpr static StrType removedLostObjects{"removedLostObjects"};
+
+        constexpr static StrType version{"version"};
+        constexpr static StrType full{"full"};
 
         constexpr static StrType defaultBagCapacity{"defaultBagCapacity"};
         constexpr static StrType bagCapacity{"bagCapacity"};
@@ -0,0 +1,403 @@
+#include "game_state_serializer.h"
+
+#include "binary_writer.h"
+#include "compression.h"
+#include "json_writer.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace http_handler {
+
+    std::shared_ptr<const std::string> GameStateSerializer::SerializedState::GetGzipBody(
+            const CompressionOptions& compression) const {
+        // Короткие тела, как и прочие динамические ответы, не сжимаются: выигрыш меньше затрат на сжатие
+        if (text.size() < compression.min_dynamic_size) {
+            return nullptr;
+        }
+        std::call_once(gzip_once_, [this, &compression] {
+            gzip_body_ = MakeGzipBody(text, compression);
+        });
+        return gzip_body_;
+    }
+
+    std::shared_ptr<const GameStateSerializer::SerializedState> GameStateSerializer::GetGameState(const model::GameSession* game_session) {
+        auto snapshot = game_session->GetSnapshot();
+        SessionState& state = GetSessionState(game_session);
+
+        auto body = state.body.load(std::memory_order_acquire);
+        if (!body || body->version != snapshot->version) {
+            std::lock_guard lock{state.mutex};
+            UpdateSessionState(state, std::move(snapshot));
+            body = state.body.load(std::memory_order_acquire);
+        }
+
+        return body;
+    }
+
+    std::shared_ptr<const GameStateSerializer::SerializedState> GameStateSerializer::GetGameStateDelta(
+            const model::GameSession* game_session, uint64_t since) {
+        auto snapshot = game_session->GetSnapshot();
+        SessionState& state = GetSessionState(game_session);
+
+        // Клиенты с одинаковым since получают один и тот же ответ, не дожидаясь блокировки.
+        // Если словарь уже собран для более новой версии, ответ тот же, что дал бы путь под блокировкой
+        if (auto cache = state.deltas.load(std::memory_order_acquire); cache && cache->version >= snapshot->version) {
+            if (auto it = cache->deltas.find(since); it != cache->deltas.end()) {
+                return it->second;
+            }
+        }
+
+        std::lock_guard lock{state.mutex};
+        UpdateSessionState(state, std::move(snapshot));
+
+        auto cache = state.deltas.load(std::memory_order_relaxed);
+        assert(cache && cache->version == state.snapshot->version);
+        // Пока ждали блокировку, этот ответ мог собрать другой поток
+        if (auto it = cache->deltas.find(since); it != cache->deltas.end()) {
+            return it->second;
+        }
+
+        auto delta = BuildDelta(state, since);
+        // Клиенты опрашивают сервер с одинаковой частотой, поэтому часто приходят с одними и теми же since.
+        // Запоминаем только since из истории, чтобы размер кэша был ограничен её глубиной.
+        const auto& history = state.snapshot->history;
+        if (!history.empty() && since >= history.front()->version && since <= state.snapshot->version) {
+            auto updated = std::make_shared<DeltaCache>(*cache);
+            updated->deltas.emplace(since, delta);
+            state.deltas.store(std::move(updated), std::memory_order_release);
+        }
+
+        return delta;
+    }
+
+    std::shared_ptr<const GameStateSerializer::SerializedState> GameStateSerializer::GetGameStateBinary(
+            const model::GameSession* game_session) {
+        auto snapshot = game_session->GetSnapshot();
+        SessionState& state = GetSessionState(game_session);
+
+        auto body = state.binary_body.load(std::memory_order_acquire);
+        if (!body || body->version < snapshot->version) {
+            std::lock_guard lock{state.mutex};
+            body = state.binary_body.load(std::memory_order_relaxed);
+            // Пока ждали блокировку, тело для этого или более нового снимка мог собрать другой поток
+            if (!body || body->version < snapshot->version) {
+                body = BuildBinaryBody(*snapshot);
+                state.binary_body.store(body, std::memory_order_release);
+            }
+        }
+
+        return body;
+    }
+
+    std::string GameStateSerializer::SerializeDogsList(const std::vector<std::shared_ptr<const model::GameSessionSnapshot::DogState>>& dogs) {
+        std::string players;
+        JsonWriter writer{players};
+
+        writer.BeginObject();
+        for (const auto& dog : dogs) {
+            writer.Key(dog->id).BeginObject().Key(gmct::name).String(dog->name).EndObject();
+        }
+        writer.EndObject();
+
+        return players;
+    }
+
+    std::string GameStateSerializer::SerializeDogsListBinary(const std::vector<std::shared_ptr<const model::GameSessionSnapshot::DogState>>& dogs) {
+        size_t names_size = 0;
+        for (const auto& dog : dogs) {
+            names_size += dog->name.size();
+        }
+
+        std::string players;
+        players.reserve(24 + dogs.size() * 8 + names_size);
+        BinaryWriter writer{players};
+
+        writer.Header(BinaryWriter::Kind::players, dogs.size(), names_size, 0, dogs.size());
+        for (const auto& dog : dogs) {
+            writer.UInt32(dog->id).UInt32(dog->name.size());
+        }
+        for (const auto& dog : dogs) {
+            writer.Bytes(dog->name);
+        }
+
+        return players;
+    }
+
+    GameStateSerializer::SessionState& GameStateSerializer::GetSessionState(const model::GameSession* game_session) {
+        {
+            std::shared_lock lock{sessions_mutex_};
+            if (auto it = sessions_.find(game_session); it != sessions_.end()) {
+                return *it->second;
+            }
+        }
+
+        std::unique_lock lock{sessions_mutex_};
+        auto& state = sessions_[game_session];
+        if (!state) {
+            state = std::make_unique<SessionState>();
+        }
+
+        return *state;
+    }
+
+    void GameStateSerializer::UpdateSessionState(SessionState& state,
+                                                 std::shared_ptr<const model::GameSessionSnapshot>&& snapshot) {
+        // Пока ждали блокировку, тело для этого или более нового снимка мог собрать другой поток
+        if (state.snapshot && state.snapshot->version >= snapshot->version) {
+            return;
+        }
+
+        UpdateFragments(state, *snapshot);
+        state.body.store(BuildBody(state, *snapshot), std::memory_order_release);
+        state.deltas.store(std::make_shared<const DeltaCache>(DeltaCache{snapshot->version, {}}),
+                           std::memory_order_release);
+        state.snapshot = std::move(snapshot);
+    }
+
+    void GameStateSerializer::UpdateFragments(SessionState& state, const model::GameSessionSnapshot& snapshot) {
+        const auto& history = snapshot.history;
+        state.dogs.resize(snapshot.dogs.size());
+
+        // Изменения всех версий после собранной есть в истории, только если она начинается не позже следующей
+        if (!state.snapshot || history.empty() || history.front()->version > state.snapshot->version + 1) {
+            for (size_t slot = 0; slot < snapshot.dogs.size(); ++slot) {
+                state.dogs[slot].clear();
+                SerializeDog(*snapshot.dogs[slot], state.dogs[slot]);
+            }
+
+            state.lost_objects.clear();
+            for (const auto& [id, loot] : *snapshot.lost_objects) {
+                SerializeLostObject(loot, state.lost_objects[id]);
+            }
+            UpdateLostObjectsText(state, snapshot);
+            return;
+        }
+
+        const size_t first = state.snapshot->version + 1 - history.front()->version;
+
+        std::vector<size_t> changed_dogs;
+        for (size_t i = first; i < history.size(); ++i) {
+            changed_dogs.insert(changed_dogs.end(), history[i]->changed_dogs.begin(), history[i]->changed_dogs.end());
+            for (size_t id : history[i]->removed_lost_objects) {
+                state.lost_objects.erase(id);
+            }
+        }
+        // Собака, менявшаяся в нескольких версиях, пересобирается один раз
+        if (history.size() - first > 1) {
+            std::sort(changed_dogs.begin(), changed_dogs.end());
+            changed_dogs.erase(std::unique(changed_dogs.begin(), changed_dogs.end()), changed_dogs.end());
+        }
+        for (size_t slot : changed_dogs) {
+            state.dogs[slot].clear();
+            SerializeDog(*snapshot.dogs[slot], state.dogs[slot]);
+        }
+
+        if (snapshot.lost_objects == state.snapshot->lost_objects) {
+            return;
+        }
+
+        // Предметы получают id по порядку. Появившиеся после собранной версии могли уже подобрать
+        const auto& previous_history = state.snapshot->history;
+        const size_t previous_next_id = previous_history.empty() ? 0 : previous_history.back()->next_lost_object_id;
+        for (size_t id = previous_next_id; id < history.back()->next_lost_object_id; ++id) {
+            if (auto it = snapshot.lost_objects->find(id); it != snapshot.lost_objects->end()) {
+                SerializeLostObject(it->second, state.lost_objects[id]);
+            }
+        }
+        UpdateLostObjectsText(state, snapshot);
+    }
+
+    void GameStateSerializer::UpdateLostObjectsText(SessionState& state, const model::GameSessionSnapshot& snapshot) {
+        state.lost_objects_text.clear();
+        JsonWriter writer{state.lost_objects_text};
+
+        writer.BeginObject();
+        for (const auto& [id, loot] : *snapshot.lost_objects) {
+            writer.Key(id).Raw(state.lost_objects.at(id));
+        }
+        writer.EndObject();
+    }
+
+    std::shared_ptr<const GameStateSerializer::SerializedState> GameStateSerializer::BuildBody(
+            const SessionState& state, const model::GameSessionSnapshot& snapshot) {
+        auto body = std::make_shared<SerializedState>();
+        body->version = snapshot.version;
+        // Размер состояния от тика к тику меняется мало, поэтому память под тело выделяем один раз
+        if (auto previous = state.body.load(std::memory_order_relaxed)) {
+            body->text.reserve(previous->text.size());
+        }
+        JsonWriter writer{body->text};
+
+        writer.BeginObject().Key(gmct::players).BeginObject();
+        for (size_t slot = 0; slot < snapshot.dogs.size(); ++slot) {
+            writer.Key(snapshot.dogs[slot]->id).Raw(state.dogs[slot]);
+        }
+        writer.EndObject();
+
+        writer.Key(gmct::lostObjects).Raw(state.lost_objects_text).EndObject();
+
+        return body;
+    }
+
+    std::shared_ptr<const GameStateSerializer::SerializedState> GameStateSerializer::BuildDelta(const SessionState& state,
+                                                                                               uint64_t since) {
+        const model::GameSessionSnapshot& snapshot = *state.snapshot;
+        const auto& history = snapshot.history;
+
+        auto delta = std::make_shared<SerializedState>();
+        delta->version = snapshot.version;
+        JsonWriter writer{delta->text};
+
+        writer.BeginObject().Key(gmct::version).UInt(snapshot.version);
+
+        // Версии since нет в истории: клиент отстал слишком сильно либо прислал версию из будущего
+        if (history.empty() || since < history.front()->version || since > snapshot.version) {
+            writer.Key(gmct::full).Raw("true");
+            // Полное тело без открывающей скобки продолжает начатый объект
+            delta->text += ',';
+            delta->text.append(state.body.load(std::memory_order_relaxed)->text, 1);
+            return delta;
+        }
+
+        // Версии в истории идут подряд
+        const size_t base = since - history.front()->version;
+        const size_t next_lost_object_id = history[base]->next_lost_object_id;
+
+        writer.Key(gmct::full).Raw("false");
+
+        std::vector<size_t> changed_dogs;
+        for (size_t i = base + 1; i < history.size(); ++i) {
+            changed_dogs.insert(changed_dogs.end(), history[i]->changed_dogs.begin(), history[i]->changed_dogs.end());
+        }
+        std::sort(changed_dogs.begin(), changed_dogs.end());
+        changed_dogs.erase(std::unique(changed_dogs.begin(), changed_dogs.end()), changed_dogs.end());
+
+        writer.Key(gmct::players).BeginObject();
+        for (size_t slot : changed_dogs) {
+            writer.Key(snapshot.dogs[slot]->id).Raw(state.dogs[slot]);
+        }
+        writer.EndObject();
+
+        // Фрагменты есть ровно для предметов, лежащих на карте в этом снимке
+        writer.Key(gmct::lostObjects).BeginObject();
+        for (size_t id = next_lost_object_id; id < history.back()->next_lost_object_id; ++id) {
+            if (auto it = state.lost_objects.find(id); it != state.lost_objects.end()) {
+                writer.Key(id).Raw(it->second);
+            }
+        }
+        writer.EndObject();
+
+        writer.Key(gmct::removedLostObjects).BeginArray();
+        for (size_t i = base + 1; i < history.size(); ++i) {
+            for (size_t id : history[i]->removed_lost_objects) {
+                // Предмет, появившийся и подобранный после since, клиент не видел
+                if (id < next_lost_object_id) {
+                    writer.UInt(id);
+                }
+            }
+        }
+        writer.EndArray().EndObject();
+
+        return delta;
+    }
+
+    std::shared_ptr<const GameStateSerializer::SerializedState> GameStateSerializer::BuildBinaryBody(
+            const model::GameSessionSnapshot& snapshot) {
+        size_t bag_items = 0;
+        for (const auto& dog : snapshot.dogs) {
+            bag_items += dog->bag.size();
+        }
+
+        auto body = std::make_shared<SerializedState>();
+        body->version = snapshot.version;
+        body->text.reserve(24 + snapshot.dogs.size() * 32 + bag_items * 8 + snapshot.lost_objects->size() * 16);
+        BinaryWriter writer{body->text};
+
+        writer.Header(BinaryWriter::Kind::state, snapshot.dogs.size(), bag_items, snapshot.lost_objects->size(),
+                      snapshot.version);
+
+        for (const auto& dog : snapshot.dogs) {
+            writer.UInt32(dog->id)
+                  .Coord(dog->pos.x).Coord(dog->pos.y)
+                  .Coord(dog->speed.horizontal).Coord(dog->speed.vertical)
+                  .UInt32(dog->score)
+                  .UInt32(dog->bag.size())
+                  .UInt8(DirectionToCode(dog->dir))
+                  .UInt8(0).UInt16(0);
+        }
+
+        for (const auto& dog : snapshot.dogs) {
+            for (auto [id, type] : dog->bag) {
+                writer.UInt32(id).UInt32(type);
+            }
+        }
+
+        for (const auto& [id, loot] : *snapshot.lost_objects) {
+            writer.UInt32(id).UInt32(loot.type).Coord(loot.pos.x).Coord(loot.pos.y);
+        }
+
+        return body;
+    }
+
+    void GameStateSerializer::SerializeDog(const model::GameSessionSnapshot::DogState& dog, std::string& out) {
+        JsonWriter writer{out};
+
+        writer.BeginObject();
+        writer.Key(gmct::pos).BeginArray().Double(dog.pos.x).Double(dog.pos.y).EndArray();
+        writer.Key(gmct::speed).BeginArray().Double(dog.speed.horizontal).Double(dog.speed.vertical).EndArray();
+        writer.Key(gmct::dir).String(DirectionToString(dog.dir));
+
+        writer.Key(gmct::bag).BeginArray();
+        for (auto [id, type] : dog.bag) {
+            writer.BeginObject().Key(gmct::id).UInt(id).Key(gmct::type).UInt(type).EndObject();
+        }
+        writer.EndArray();
+
+        writer.Key(gmct::score).UInt(dog.score);
+        writer.EndObject();
+    }
+
+    void GameStateSerializer::SerializeLostObject(const model::Loot& loot, std::string& out) {
+        JsonWriter writer{out};
+
+        writer.BeginObject();
+        writer.Key(gmct::type).UInt(loot.type);
+        writer.Key(gmct::pos).BeginArray().Double(loot.pos.x).Double(loot.pos.y).EndArray();
+        writer.EndObject();
+    }
+
+    std::string_view GameStateSerializer::DirectionToString(model::Direction dir) {
+        switch (dir) {
+            case model::Direction::UP:
+                return "U";
+            case model::Direction::LEFT:
+                return "L";
+            case model::Direction::RIGHT:
+                return "R";
+            case model::Direction::DOWN:
+                return "D";
+            case model::Direction::STOP:
+                break;
+        }
+
+        return "";
+    }
+
+    uint8_t GameStateSerializer::DirectionToCode(model::Direction dir) {
+        switch (dir) {
+            case model::Direction::UP:
+                return 0;
+            case model::Direction::DOWN:
+                return 1;
+            case model::Direction::LEFT:
+                return 2;
+            case model::Direction::RIGHT:
+                return 3;
+            case model::Direction::STOP:
+                break;
+        }
+
+        return 4;
+    }
+}  // namespace http_handler
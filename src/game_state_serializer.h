@@ -0,0 +1,126 @@
+#pragma once
+
+#include <boost/json.hpp>
+
+#include "model.h"
+#include "game_model_content_type.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace http_handler {
+    namespace json = boost::json;
+
+    struct CompressionOptions;
+
+    // Сериализует состояние игровых сессий для запроса /api/v1/game/state.
+    // Для каждой собаки и каждого предмета хранится готовый JSON-фрагмент. По истории изменений снимка
+    // пересобираются только фрагменты изменившихся собак и появившихся предметов. Тело ответа склеивается
+    // из фрагментов один раз на каждый снимок сессии и затем раздаётся всем игрокам этой сессии.
+    class GameStateSerializer {
+    public:
+        // Ключи игровой модели для JSON
+        using gmct = model::GameModelContentType<boost::string_view>;
+
+        GameStateSerializer() = default;
+
+        GameStateSerializer(const GameStateSerializer&) = delete;
+        GameStateSerializer& operator=(const GameStateSerializer&) = delete;
+
+        // Тело ответа и версия снимка сессии, из которого оно собрано
+        struct SerializedState {
+            uint64_t version = 0;
+            std::string text;
+
+            // Тело, сжатое в gzip; nullptr, если сжатие отключено, тело короче min_dynamic_size
+            // или сжатие его не уменьшает.
+            // Сжимается при первом запросе и затем раздаётся всем клиентам, принимающим gzip.
+            // Может вызываться из любого потока.
+            std::shared_ptr<const std::string> GetGzipBody(const CompressionOptions& compression) const;
+
+        private:
+            mutable std::once_flag gzip_once_;
+            mutable std::shared_ptr<const std::string> gzip_body_;
+        };
+
+        // Тело ответа для последнего снимка сессии. Может вызываться из любого потока.
+        std::shared_ptr<const SerializedState> GetGameState(const model::GameSession* game_session);
+
+        // Изменения с версии снимка since: собаки, изменившиеся после неё, появившиеся и подобранные предметы.
+        // Если since вышла за пределы истории, возвращает полное состояние с признаком full.
+        // Может вызываться из любого потока.
+        std::shared_ptr<const SerializedState> GetGameStateDelta(const model::GameSession* game_session, uint64_t since);
+
+        // Последний снимок сессии в двоичном формате (см. BinaryWriter). Собирается при первом запросе
+        // к снимку и раздаётся всем клиентам. Может вызываться из любого потока.
+        std::shared_ptr<const SerializedState> GetGameStateBinary(const model::GameSession* game_session);
+
+        // Список игроков сессии для /api/v1/game/players: имена собак по их id
+        static std::string SerializeDogsList(const std::vector<std::shared_ptr<const model::GameSessionSnapshot::DogState>>& dogs);
+
+        // Тот же список в двоичном формате (см. BinaryWriter)
+        static std::string SerializeDogsListBinary(const std::vector<std::shared_ptr<const model::GameSessionSnapshot::DogState>>& dogs);
+
+    private:
+
+        // Разностные ответы для одной версии снимка по значению since. После публикации не изменяется
+        struct DeltaCache {
+            uint64_t version = 0;
+            std::unordered_map<uint64_t, std::shared_ptr<const SerializedState>> deltas;
+        };
+
+        struct SessionState {
+            // Последнее собранное тело ответа, пока тело не собрано - nullptr. Читается без блокировки
+            std::atomic<std::shared_ptr<const SerializedState>> body;
+            // Двоичное тело, собранное последним, пока не запрошено - nullptr. Читается без блокировки
+            std::atomic<std::shared_ptr<const SerializedState>> binary_body;
+            // Разностные ответы для версии snapshot. Читаются без блокировки,
+            // новый ответ добавляется в копию словаря под mutex, и копия заменяет прежний словарь
+            std::atomic<std::shared_ptr<const DeltaCache>> deltas;
+
+            // Защищает остальные поля. Сборку тела для одной версии выполняет один поток, остальные её дожидаются
+            std::mutex mutex;
+            // Снимок, из которого собраны тело и фрагменты
+            std::shared_ptr<const model::GameSessionSnapshot> snapshot;
+            // Фрагменты собак по слотам
+            std::vector<std::string> dogs;
+            // Фрагменты предметов по id и собранный из них объект lostObjects.
+            // Объект пересобирается, только когда в снимке меняется набор предметов
+            std::unordered_map<size_t, std::string> lost_objects;
+            std::string lost_objects_text;
+        };
+
+        std::shared_mutex sessions_mutex_;
+        std::unordered_map<const model::GameSession*, std::unique_ptr<SessionState>> sessions_;
+
+        SessionState& GetSessionState(const model::GameSession* game_session);
+
+        // Пересобирает тело и фрагменты, если snapshot новее собранного. Вызывается под state.mutex
+        static void UpdateSessionState(SessionState& state, std::shared_ptr<const model::GameSessionSnapshot>&& snapshot);
+
+        // Пересобирает фрагменты собак и предметов, изменившихся после state.snapshot.
+        // Если история snapshot не покрывает эти изменения, пересобирает все фрагменты
+        static void UpdateFragments(SessionState& state, const model::GameSessionSnapshot& snapshot);
+
+        static void UpdateLostObjectsText(SessionState& state, const model::GameSessionSnapshot& snapshot);
+
+        static std::shared_ptr<const SerializedState> BuildBody(const SessionState& state, const model::GameSessionSnapshot& snapshot);
+
+        static std::shared_ptr<const SerializedState> BuildDelta(const SessionState& state, uint64_t since);
+
+        static std::shared_ptr<const SerializedState> BuildBinaryBody(const model::GameSessionSnapshot& snapshot);
+
+        static void SerializeDog(const model::GameSessionSnapshot::DogState& dog, std::string& out);
+
+        static void SerializeLostObject(const model::Loot& loot, std::string& out);
+
+        static std::string_view DirectionToString(model::Direction dir);
+
+        static uint8_t DirectionToCode(model::Direction dir);
+    };
+}  // namespace http_handler
@@ -14,6 +14,7 @@ namespace http_handler {
         constexpr static std::string_view IMAGE_SVG = "image/svg+xml"sv;
         constexpr static std::string_view IMAGE_PNG = "image/png"sv;
         constexpr static std::string_view APPLICATION_OCTET_STREAM = "application/octet-stream"sv;
+        constexpr static std::string_view TEXT_EVENT_STREAM = "text/event-stream"sv;
     };
 
     struct ErrorMessages {
@@ -35,6 +36,8 @@ namespace http_handler {
         constexpr static std::string_view unknownToken = "{\"code\": \"unknownToken\", \"message\": \"Player token has not been found\"}"sv;
         constexpr static std::string_view invalidArgumentToParseAction = "{\"code\": \"invalidArgument\", \"message\": \"Failed to parse action\"}"sv;
         constexpr static std::string_view invalidArgumentToParseJSON = "{\"code\": \"invalidArgument\", \"message\": \"Failed to parse tick request JSON\"}"sv;
+        constexpr static std::string_view tickFailed = "{\"code\": \"internalError\", \"message\": \"Game tick failed\"}"sv;
+        constexpr static std::string_view invalidArgumentToParseSince = "{\"code\": \"invalidArgument\", \"message\": \"Invalid state version\"}"sv;
     };
 
     struct ApiRequestType {
@@ -45,6 +48,18 @@ namespace http_handler {
         constexpr static std::string_view state = "/api/v1/game/state"sv;
         constexpr static std::string_view action = "/api/v1/game/player/action"sv;
         constexpr static std::string_view tick = "/api/v1/game/tick"sv;
+        // Переход на WebSocket для получения состояния после каждого тика
+        constexpr static std::string_view websocket = "/api/v1/game/ws"sv;
+        // Поток text/event-stream с изменениями состояния игры на карте, доступен без токена
+        constexpr static std::string_view spectate = "/api/v1/game/spectate"sv;
+    };
+
+    // Параметры строки запроса к API
+    struct ApiQueryParam {
+        // Версия состояния игры, относительно которой клиент хочет получить изменения
+        constexpr static std::string_view since = "since"sv;
+        // Карта, за игрой на которой наблюдает зритель
+        constexpr static std::string_view map = "map"sv;
     };
 
     struct GetFileRequestType {
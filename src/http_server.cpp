@@ -1,4 +1,5 @@
 #include "http_server.h"
+#include "http_handler_string_constants.h"
 
 #include <boost/asio/dispatch.hpp>
 
@@ -35,6 +36,12 @@ namespace http_server {
 
             return log_(std::move(error_log), "error"sv);
         }
+        if (stream_handler_ && (websocket::is_upgrade(request_) || IsEventStreamRequest(request_))) {
+            // Дальше соединением владеет потоковый обработчик, таймаут HTTP-сессии ему не нужен
+            stream_.expires_never();
+            std::string user_ip = GetIPFromSocket();
+            return stream_handler_(stream_.release_socket(), std::move(request_), std::move(user_ip));
+        }
         HandleRequest(std::move(request_), std::move(GetIPFromSocket()));
     }
 
@@ -69,6 +76,14 @@ namespace http_server {
         Read();
     }
 
+    bool SessionBase::IsEventStreamRequest(const HttpRequest& request) {
+        // Так подписывается EventSource в браузере. Прочие запросы с таким Accept обрабатываются как обычные
+        std::string_view target = request.target();
+        return request.method() == http::verb::get
+               && target.substr(0, target.find('?')) == http_handler::ApiRequestType::spectate
+               && request[http::field::accept].find(http_handler::ContentType::TEXT_EVENT_STREAM) != std::string_view::npos;
+    }
+
     std::string SessionBase::GetIPFromSocket() const {
         return stream_.socket().remote_endpoint().address().to_string();
     }
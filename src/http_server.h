@@ -3,10 +3,12 @@
 // boost.beast будет использовать std::string_view вместо boost::string_view
 #define BOOST_BEAST_USE_STD_STRING_VIEW
 
+#include <boost/asio/dispatch.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
 
 #include <boost/json.hpp>
 
@@ -18,10 +20,14 @@ namespace http_server {
     using tcp = net::ip::tcp;
     namespace beast = boost::beast;
     namespace http = beast::http;
+    namespace websocket = beast::websocket;
     namespace sys = boost::system;
 
     namespace json = boost::json;
     using Logger = std::function<void(json::value, std::string_view)>;
+    // Получает сокет, запрос, после которого соединение становится потоковым, и IP клиента: переход на WebSocket
+    // или подписка зрителя на text/event-stream. После вызова HTTP-сессия с сокетом больше не работает
+    using StreamHandler = std::function<void(tcp::socket&&, http::request<http::string_body>&&, std::string&&)>;
 
     using namespace std::string_view_literals;
 
@@ -34,24 +40,29 @@ namespace http_server {
         void Run();
 
     protected:
-        explicit SessionBase(tcp::socket&& socket, const Logger& log)
+        explicit SessionBase(tcp::socket&& socket, const StreamHandler& stream_handler, const Logger& log)
                 : stream_(std::move(socket))
+                , stream_handler_(stream_handler)
                 , log_(log){
         }
         using HttpRequest = http::request<http::string_body>;
 
         ~SessionBase() = default;
 
+        // Может вызываться из любого потока: ответы к API формируются на strand'ах игры
         template <typename Body, typename Fields>
         void Write(http::response<Body, Fields>&& response) {
             // Запись выполняется асинхронно, поэтому response перемещаем в область кучи
             auto safe_response = std::make_shared<http::response<Body, Fields>>(std::move(response));
 
             auto self = GetSharedThis();
-            http::async_write(stream_, *safe_response,
-                              [safe_response, self](beast::error_code ec, std::size_t bytes_written) {
-                                  self->OnWrite(safe_response->need_eof(), ec, bytes_written);
-                              });
+            // Операции с потоком выполняем только в его собственном strand, чтобы не пересекаться с таймером и чтением
+            net::dispatch(stream_.get_executor(), [safe_response, self] {
+                http::async_write(self->stream_, *safe_response,
+                                  [safe_response, self](beast::error_code ec, std::size_t bytes_written) {
+                                      self->OnWrite(safe_response->need_eof(), ec, bytes_written);
+                                  });
+            });
         }
 
     private:
@@ -59,6 +70,7 @@ namespace http_server {
         beast::tcp_stream stream_;
         beast::flat_buffer buffer_;
         HttpRequest request_;
+        const StreamHandler& stream_handler_;
         const Logger& log_;
 
         void Read();
@@ -71,6 +83,8 @@ namespace http_server {
 
         [[nodiscard]] std::string GetIPFromSocket() const;
 
+        static bool IsEventStreamRequest(const HttpRequest& request);
+
         // Обработку запроса делегируем подклассу
         virtual void HandleRequest(HttpRequest&& request, std::string&& user_ip) = 0;
 
@@ -81,8 +95,8 @@ namespace http_server {
     class Session : public SessionBase, public std::enable_shared_from_this<Session<RequestHandler>> {
     public:
         template <typename Handler>
-        Session(tcp::socket&& socket, Handler&& request_handler, const Logger& log)
-                : SessionBase(std::move(socket), log)
+        Session(tcp::socket&& socket, Handler&& request_handler, const StreamHandler& stream_handler, const Logger& log)
+                : SessionBase(std::move(socket), stream_handler, log)
                 , request_handler_(std::forward<Handler>(request_handler)) {
         }
 
@@ -107,11 +121,13 @@ namespace http_server {
     class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
     public:
         template <typename Handler>
-        Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler, const Logger& log)
+        Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler,
+                 const StreamHandler& stream_handler, const Logger& log)
                 : ioc_(ioc)
                 // Обработчики асинхронных операций acceptor_ будут вызываться в своём strand
                 , acceptor_(net::make_strand(ioc))
                 , request_handler_(std::forward<Handler>(request_handler))
+                , stream_handler_(stream_handler)
                 , log_(log) {
             // Открываем acceptor, используя протокол (IPv4 или IPv6), указанный в endpoint
             acceptor_.open(endpoint.protocol());
@@ -136,6 +152,7 @@ namespace http_server {
         net::io_context& ioc_;
         tcp::acceptor acceptor_;
         RequestHandler request_handler_;
+        const StreamHandler& stream_handler_;
         const Logger& log_;
 
         void DoAccept() {
@@ -174,17 +191,20 @@ namespace http_server {
         }
 
         void AsyncRunSession(tcp::socket&& socket) {
-            std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_, log_)->Run();
+            std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_, stream_handler_, log_)->Run();
         }
     };
 
+    // Запросы на переход к WebSocket и подписки на text/event-stream передаются в stream_handler, если он задан,
+    // остальные - в handler
     template <typename RequestHandler>
-    void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler, const Logger& log) {
+    void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler,
+                   const StreamHandler& stream_handler, const Logger& log) {
         // При помощи decay_t исключим ссылки из типа RequestHandler,
         // чтобы Listener хранил RequestHandler по значению
         using MyListener = Listener<std::decay_t<RequestHandler>>;
 
-        std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler), log)->Run();
+        std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler), stream_handler, log)->Run();
     }
 
 }  // namespace http_server
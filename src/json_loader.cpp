@@ -103,9 +103,7 @@ namespace json_loader {
         return std::move(input.str());
     }
 
-    model::Game JsonLoader::LoadGame() {
-        Game game;
-
+    void JsonLoader::LoadGame(model::Game& game) {
         if (const auto* dog_speed_ptr = config_data_.if_contains(gmct::default_dog_speed)) {
             game.SetDefaultDogSpeed(dog_speed_ptr->as_double());
         }
@@ -121,8 +119,6 @@ namespace json_loader {
         }
 
         SetMaps(game);
-
-        return game;
     }
 
     extra_data::FrontendData JsonLoader::LoadFrontendData() {
@@ -18,7 +18,8 @@ namespace json_loader {
         : config_data_{std::move(json::parse(GetFileStr(json_path)).as_object())} {
         }
 
-        model::Game LoadGame();
+        // Game не перемещается (содержит мьютексы), поэтому заполняется на месте
+        void LoadGame(model::Game& game);
 
         extra_data::FrontendData LoadFrontendData();
 
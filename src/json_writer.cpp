@@ -0,0 +1,108 @@
+#include "json_writer.h"
+
+#include <charconv>
+#include <limits>
+
+namespace http_handler {
+
+    JsonWriter& JsonWriter::BeginObject() {
+        BeforeValue();
+        out_ += '{';
+        need_comma_ = false;
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::EndObject() {
+        out_ += '}';
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::BeginArray() {
+        BeforeValue();
+        out_ += '[';
+        need_comma_ = false;
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::EndArray() {
+        out_ += ']';
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::Key(json::string_view key) {
+        BeforeValue();
+        serializer_.reset(key);
+        AppendSerialized();
+        out_ += ':';
+        // Значение идёт сразу за ключом без запятой
+        need_comma_ = false;
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::Key(std::uint64_t id) {
+        BeforeValue();
+        out_ += '"';
+        AppendUInt(id);
+        out_ += "\":";
+        need_comma_ = false;
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::String(std::string_view value) {
+        BeforeValue();
+        serializer_.reset(json::string_view{value.data(), value.size()});
+        AppendSerialized();
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::UInt(std::uint64_t value) {
+        BeforeValue();
+        AppendUInt(value);
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::Double(double value) {
+        BeforeValue();
+        // Скалярное значение не выделяет память, а формат числа остаётся тем же, что у json::serialize
+        const json::value jv = value;
+        serializer_.reset(&jv);
+        AppendSerialized();
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& JsonWriter::Raw(std::string_view json) {
+        BeforeValue();
+        out_ += json;
+        need_comma_ = true;
+        return *this;
+    }
+
+    void JsonWriter::BeforeValue() {
+        if (need_comma_) {
+            out_ += ',';
+        }
+    }
+
+    void JsonWriter::AppendUInt(std::uint64_t value) {
+        char buf[std::numeric_limits<std::uint64_t>::digits10 + 1];
+        auto [end, ec] = std::to_chars(std::begin(buf), std::end(buf), value);
+        out_.append(buf, end);
+    }
+
+    void JsonWriter::AppendSerialized() {
+        // Запись числа или короткой строки укладывается в один проход
+        constexpr size_t chunk_size = 64;
+
+        while (!serializer_.done()) {
+            const size_t size = out_.size();
+            out_.resize(size + chunk_size);
+            auto written = serializer_.read(out_.data() + size, chunk_size);
+            out_.resize(size + written.size());
+        }
+    }
+}  // namespace http_handler
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <boost/json.hpp>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace http_handler {
+    namespace json = boost::json;
+
+    // Дописывает JSON прямо в строку, не строя дерево json::value.
+    // Строки и дробные числа форматирует json::serializer, поэтому результат совпадает с json::serialize
+    // для того же документа байт в байт. Запятые между элементами расставляются автоматически.
+    class JsonWriter {
+    public:
+        explicit JsonWriter(std::string& out)
+                : out_(out) {
+        }
+
+        JsonWriter(const JsonWriter&) = delete;
+        JsonWriter& operator=(const JsonWriter&) = delete;
+
+        JsonWriter& BeginObject();
+        JsonWriter& EndObject();
+
+        JsonWriter& BeginArray();
+        JsonWriter& EndArray();
+
+        JsonWriter& Key(json::string_view key);
+        // Ключ-идентификатор: json::serialize записал бы std::to_string(id) в кавычках
+        JsonWriter& Key(std::uint64_t id);
+
+        JsonWriter& String(std::string_view value);
+        JsonWriter& UInt(std::uint64_t value);
+        JsonWriter& Double(double value);
+        // Готовый JSON-фрагмент, вставляемый как значение без изменений
+        JsonWriter& Raw(std::string_view json);
+
+    private:
+        std::string& out_;
+        // Нужна ли запятая перед следующим элементом текущего объекта или массива
+        bool need_comma_ = false;
+        json::serializer serializer_;
+
+        void BeforeValue();
+
+        void AppendUInt(std::uint64_t value);
+
+        // Дописывает в out_ всё, что выдаёт serializer_ после reset
+        void AppendSerialized();
+    };
+}  // namespace http_handler
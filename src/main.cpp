@@ -16,10 +16,14 @@
 #include <boost/program_options.hpp>
 #include <optional>
 
+#include "collision_batch.h"
 #include "json_loader.h"
 #include "request_handler.h"
 #include "server_logging.h"
 #include "ticker.h"
+#include "spectator_hub.h"
+#include "websocket_hub.h"
+#include "worker_pool.h"
 
 #include <iostream>
 #include <thread>
@@ -55,6 +59,12 @@ namespace {
         std::string file;
         std::string dir;
         bool spawn_points_are_random;
+        collision_detector::Engine collision_engine = collision_detector::Engine::UNIFORM_GRID;
+        unsigned io_threads = std::thread::hardware_concurrency();
+        unsigned simulation_threads = std::thread::hardware_concurrency();
+        size_t collision_parallel_threshold = collision_detector::ParallelOptions::DEFAULT_WORK_THRESHOLD;
+        http_handler::CompressionOptions compression;
+        bool watch_www_root;
     };
 
     [[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
@@ -63,13 +73,28 @@ namespace {
         po::options_description desc{"All options"s};
 
         std::string milliseconds;
+        std::string collision_engine;
         Args args;
         desc.add_options()
                 ("help,h", "produce help message")
                 ("tick-period,t", po::value(&milliseconds)->value_name("milliseconds"s), "set tick period")
                 ("config-file,c", po::value(&args.file)->value_name("file"s), "set config file path")
                 ("www-root,w", po::value(&args.dir)->value_name("dir"s), "set static files root")
-                ("randomize-spawn-points", "spawn dogs at random positions");
+                ("watch-www-root", "reload static files when they change (Linux only)")
+                ("randomize-spawn-points", "spawn dogs at random positions")
+                ("collision-engine", po::value(&collision_engine)->value_name("grid|brute-force"s),
+                        "set collision detection engine (grid by default)")
+                ("io-threads", po::value(&args.io_threads)->value_name("count"s),
+                        "set number of threads serving requests and ticking game sessions of different maps in parallel "
+                        "(hardware concurrency by default)")
+                ("simulation-threads", po::value(&args.simulation_threads)->value_name("count"s),
+                        "set number of threads for parallel work inside a game session tick (hardware concurrency by default)")
+                ("collision-parallel-threshold", po::value(&args.collision_parallel_threshold)->value_name("checks"s),
+                        "search collisions in parallel when a tick needs at least this many gatherer-item checks")
+                ("gzip-level", po::value(&args.compression.level)->value_name("0-9"s),
+                        "set gzip compression level for responses, 0 disables compression (6 by default)")
+                ("gzip-min-size", po::value(&args.compression.min_dynamic_size)->value_name("bytes"s),
+                        "compress dynamic API responses only if their body is at least this large (1024 by default)");
 
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -93,6 +118,21 @@ namespace {
         }
 
         args.spawn_points_are_random = vm.contains("randomize-spawn-points"s);
+        args.watch_www_root = vm.contains("watch-www-root"s);
+
+        if (vm.contains("collision-engine"s)) {
+            if (collision_engine == "grid"s) {
+                args.collision_engine = collision_detector::Engine::UNIFORM_GRID;
+            } else if (collision_engine == "brute-force"s) {
+                args.collision_engine = collision_detector::Engine::BRUTE_FORCE;
+            } else {
+                throw std::runtime_error("Unknown collision engine "s + collision_engine);
+            }
+        }
+
+        if (args.compression.level < 0 || args.compression.level > 9) {
+            throw std::runtime_error("Gzip level must be between 0 and 9"s);
+        }
 
         return args;
     }
@@ -144,16 +184,21 @@ int main(int argc, const char* argv[]) {
             // 1. Загружаем конфиг из файла
             json_loader::JsonLoader json_loader(args->file);
             // 1.1 Строим модель игры
-            game = json_loader.LoadGame();
+            json_loader.LoadGame(game);
             // 1.2 Получаем данные необходимые фронтенду
             frontend_data = json_loader.LoadFrontendData();
         }
         // 1.3 Устанавливаем параметр спавна игроков
         game.SetSpawnPointsRandom(args->spawn_points_are_random);
+        // 1.4 Устанавливаем способ поиска столкновений
+        game.SetCollisionEngine(args->collision_engine);
+        // 1.5 Пул потоков для вычислений внутри тика
+        util::WorkerPool simulation_pool(args->simulation_threads);
+        game.SetCollisionParallelOptions({&simulation_pool, args->collision_parallel_threshold});
 
 
-        // 2. Инициализируем io_context
-        const unsigned num_threads = std::thread::hardware_concurrency();
+        // 2. Инициализируем io_context. На его потоках обрабатываются запросы и тики сессий разных карт
+        const unsigned num_threads = std::max(1u, args->io_threads);
         net::io_context ioc(num_threads);
 
         // 3. Добавляем асинхронный обработчик сигналов SIGINT и SIGTERM
@@ -165,17 +210,37 @@ int main(int argc, const char* argv[]) {
             }
         });
 
-        // strand для выполнения запросов к API
-        auto api_strand = net::make_strand(ioc);
+        // Статические файлы загружаются в память один раз и затем отдаются без обращений к диску
+        http_handler::StaticFileCache static_files(args->dir, args->compression);
+        if (args->watch_www_root) {
+            static_files.Watch(ioc);
+        }
+
+        // strand'ы для выполнения запросов к API: по одному на карту и общий
+        http_handler::ApiStrands api_strands(ioc, game, logger);
+
+        // Тела состояния игры общие для HTTP-запросов, WebSocket-подписчиков и зрителей
+        http_handler::GameStateSerializer state_serializer;
+        http_handler::WebSocketHub websocket_hub(game, api_strands, state_serializer);
+        http_handler::SpectatorHub spectator_hub(game, state_serializer);
+        api_strands.SetTickHandler([&websocket_hub, &spectator_hub](const model::GameSession* session) {
+            websocket_hub.NotifySubscribers(session);
+            spectator_hub.Broadcast(session);
+        });
 
         bool is_update_time_shift_automatic = args->milliseconds.has_value();
         std::shared_ptr<time_shift::Ticker> ticker;
 
         if (is_update_time_shift_automatic) {
             std::chrono::milliseconds period = args->milliseconds.value() * 1ms;
-            ticker = std::make_shared<time_shift::Ticker>(api_strand, period,
-                                                               [&game](std::chrono::milliseconds delta) {
-                    game.SetTimeShift(std::chrono::duration<double>(delta).count());
+            ticker = std::make_shared<time_shift::Ticker>(api_strands.GetGlobalStrand(), period,
+                                                               [&api_strands](std::chrono::milliseconds delta, auto&& on_complete) {
+                    // Следующий тик начнётся, когда все игровые сессии закончат этот, даже если тик какой-то
+                    // из них завершился ошибкой: ошибки записывает в журнал api_strands
+                    api_strands.PostTimeShift(std::chrono::duration<double>(delta).count(),
+                                              [on_complete = std::move(on_complete)]([[maybe_unused]] bool all_ticked) {
+                        on_complete();
+                    });
                 }
             );
             ticker->Start();
@@ -183,8 +248,10 @@ int main(int argc, const char* argv[]) {
         
         // 4. Создаём обработчик HTTP-запросов и связываем его с моделью игры
         auto handler = std::make_shared<http_handler::RequestHandler>(game,
-                                                                      args->dir,
-                                                                      api_strand,
+                                                                      static_files,
+                                                                      api_strands,
+                                                                      state_serializer,
+                                                                      args->compression,
                                                                       std::move(frontend_data),
                                                                       is_update_time_shift_automatic);
 
@@ -193,22 +260,40 @@ int main(int argc, const char* argv[]) {
         const auto address = net::ip::make_address("0.0.0.0");
         constexpr net::ip::port_type port = 8080;
 
+        // Переход на WebSocket принимает websocket_hub, подписки на text/event-stream - spectator_hub.
+        // Такие запросы попадают в журнал так же, как обычные
+        const http_server::StreamHandler stream_handler = [&websocket_hub, &spectator_hub, &logger](auto&& socket, auto&& req,
+                                                                                                    auto&& user_ip) {
+            server_logging::LoggingRequestHandler::LogRequest(logger, req, std::move(user_ip));
+            if (http_server::websocket::is_upgrade(req)) {
+                websocket_hub.Accept(std::move(socket), std::move(req));
+            } else {
+                spectator_hub.Accept(std::move(socket), std::move(req));
+            }
+        };
+
         // 5. Запустить обработчик HTTP-запросов, делегируя их обработчику запросов
         http_server::ServeHttp(ioc, {address, port}, [&request_logger, &logger](auto&& endpoint, auto&& req, auto&& send) {
             request_logger(std::forward<decltype(endpoint)>(endpoint),
                            std::forward<decltype(req)>(req),
                            std::forward<decltype(send)>(send),
                            std::forward<decltype(logger)>(logger));
-            }, logger);
+            }, stream_handler, logger);
 
         // Эта надпись сообщает тестам о том, что сервер запущен и готов обрабатывать запросы
         {
             json::value data_for_log_start_server{{"port", port}, {"address", address.to_string()}};
             logger(std::move(data_for_log_start_server), "server started"sv);
         }
+        {
+            const auto engine = args->collision_engine == collision_detector::Engine::UNIFORM_GRID ? "grid"sv : "brute-force"sv;
+            json::value data_for_log_collisions{{"engine", engine},
+                                                {"kernel", collision_detector::GetBatchKernelName()}};
+            logger(std::move(data_for_log_collisions), "collision detection"sv);
+        }
 
         // 6. Запускаем обработку асинхронных операций
-        RunWorkers(std::max(1u, num_threads), [&ioc] {
+        RunWorkers(num_threads, [&ioc] {
             ioc.run();
         });
 
@@ -1,10 +1,16 @@
 #include "model.h"
 
+#include <algorithm>
+#include <array>
 #include <iomanip>
+#include <numeric>
 
 namespace model {
 
     void Dog::SetMovementParameters(Direction dir, double default_dog_speed) {
+        Speed& speed_ = state_->speeds[slot_];
+        const Speed previous_speed = speed_;
+        const Direction previous_dir = state_->directions[slot_];
         switch (dir) {
             case Direction::UP:
                 speed_.horizontal = 0.; speed_.vertical = -default_dog_speed;
@@ -20,70 +26,295 @@ namespace model {
                 break;
             case Direction::STOP:
                 speed_.horizontal = 0.; speed_.vertical = 0.;
-                return;
+                break;
+        }
+        if (dir != Direction::STOP) {
+            state_->directions[slot_] = dir;
+        }
+
+        // Повторная команда того же движения собаку не меняет
+        if (speed_ != previous_speed || state_->directions[slot_] != previous_dir) {
+            state_->MarkChanged(slot_);
         }
-        dir_ = dir;
     }
 
-    //Определения методов класса GameSession
-    using namespace std::chrono_literals;
-    GameSession::GameSession(const Map* map, bool spawn_points_are_random, double period, double probability)
-            : map_(map)
-            , spawn_points_are_random_(spawn_points_are_random)
-            , loot_generator_(std::chrono::duration_cast<std::chrono::milliseconds>(period * 1ms), probability)
-    {
-        for(const auto& road : map->GetRoads()) {
-            auto point_start = std::make_pair(road.GetStart().x, road.GetStart().y);
-            auto point_end = std::make_pair(road.GetEnd().x, road.GetEnd().y);
+    //Определения методов класса RoadGraph
+    RoadGraph::RoadGraph(const std::vector<Road>& roads) {
+        roads_.reserve(roads.size());
+        for (const auto& road : roads) {
+            auto start = road.GetStart();
+            auto end = road.GetEnd();
+            //Приводим дороги к виду при котором стартовая координата всегда меньше конечной
             if (road.IsHorizontal()) {
-                //Приводим дороги к виду при котором стартовая координата всегда меньше конечной
-                if (road.GetStart().x < road.GetEnd().x) {
-                    directed_roads_.emplace_back(Road{Road::HORIZONTAL, road.GetStart(), road.GetEnd().x});
-                    directed_ptr_roads_.push_back(&directed_roads_.back());
-                    point_to_right_road_.insert({point_start, &directed_roads_.back()});
-                    point_to_left_road_.insert({point_end, &directed_roads_.back()});
-                } else {
-                    //Тут как-бы переворачиваем дору
-                    directed_roads_.emplace_back(Road{Road::HORIZONTAL, road.GetEnd(), road.GetStart().x});
-                    directed_ptr_roads_.push_back(&directed_roads_.back());
-                    point_to_right_road_.insert({point_end, &directed_roads_.back()});
-                    point_to_left_road_.insert({point_start, &directed_roads_.back()});
+                if (end.x < start.x) {
+                    std::swap(start, end);
                 }
+                roads_.emplace_back(Road{Road::HORIZONTAL, start, end.x});
             } else {
-                if (road.GetStart().y < road.GetEnd().y) {
-                    directed_roads_.emplace_back(Road{Road::VERTICAL, road.GetStart(), road.GetEnd().y});
-                    directed_ptr_roads_.push_back(&directed_roads_.back());
-                    point_to_down_road_.insert({point_start, &directed_roads_.back()});
-                    point_to_up_road_.insert({point_end, &directed_roads_.back()});
-                } else {
-                    directed_roads_.emplace_back(Road{Road::VERTICAL, road.GetEnd(), road.GetStart().y});
-                    directed_ptr_roads_.push_back(&directed_roads_.back());
-                    point_to_down_road_.insert({point_end, &directed_roads_.back()});
-                    point_to_up_road_.insert({point_start, &directed_roads_.back()});
+                if (end.y < start.y) {
+                    std::swap(start, end);
                 }
+                roads_.emplace_back(Road{Road::VERTICAL, start, end.y});
+            }
+        }
+
+        // Объединяем соединённые или перекрывающиеся дороги одной прямой в коридоры.
+        // Для горизонтальной дороги ось - y, а отрезок - [start.x, end.x], для вертикальной наоборот.
+        auto get_axis = [](const Road& road) {
+            return road.IsHorizontal() ? road.GetStart().y : road.GetStart().x;
+        };
+        auto get_segment = [](const Road& road) {
+            return road.IsHorizontal() ? std::make_pair(road.GetStart().x, road.GetEnd().x)
+                                       : std::make_pair(road.GetStart().y, road.GetEnd().y);
+        };
+
+        std::vector<RoadId> order(roads_.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](RoadId lhs, RoadId rhs) {
+            const Road& l = roads_[lhs];
+            const Road& r = roads_[rhs];
+            return std::make_tuple(!l.IsHorizontal(), get_axis(l), get_segment(l).first)
+                   < std::make_tuple(!r.IsHorizontal(), get_axis(r), get_segment(r).first);
+        });
+
+        road_to_corridor_.resize(roads_.size());
+        for (RoadId id : order) {
+            const Road& road = roads_[id];
+            auto [begin, end] = get_segment(road);
+            if (!corridors_.empty()) {
+                Road& last = corridors_.back();
+                if (last.IsHorizontal() == road.IsHorizontal() && get_axis(last) == get_axis(road)
+                    && begin <= get_segment(last).second) {
+                    const Coord new_end = std::max(end, get_segment(last).second);
+                    last = road.IsHorizontal() ? Road{Road::HORIZONTAL, last.GetStart(), new_end}
+                                               : Road{Road::VERTICAL, last.GetStart(), new_end};
+                    road_to_corridor_[id] = static_cast<CorridorId>(corridors_.size() - 1);
+                    continue;
+                }
+            }
+            road_to_corridor_[id] = static_cast<CorridorId>(corridors_.size());
+            corridors_.push_back(road);
+        }
+
+        // Точки, от которых условно начинаются дороги при движении в каждом из направлений:
+        // координата границы вдоль направления, координата поперёк и коридор дороги
+        struct Entry {
+            Coord boundary;
+            Coord cross_coord;
+            CorridorId corridor;
+        };
+        std::array<std::vector<Entry>, DIRECTIONS_COUNT> entries;
+
+        for (RoadId id = 0; id < roads_.size(); ++id) {
+            auto start = roads_[id].GetStart();
+            auto end = roads_[id].GetEnd();
+            const CorridorId corridor = road_to_corridor_[id];
+            if (roads_[id].IsHorizontal()) {
+                entries[static_cast<size_t>(Direction::RIGHT)].push_back({start.x, start.y, corridor});
+                entries[static_cast<size_t>(Direction::LEFT)].push_back({end.x, end.y, corridor});
+            } else {
+                entries[static_cast<size_t>(Direction::DOWN)].push_back({start.y, start.x, corridor});
+                entries[static_cast<size_t>(Direction::UP)].push_back({end.y, end.x, corridor});
+            }
+        }
+
+        crossing_ranges_.assign(corridors_.size() * DIRECTIONS_COUNT, {});
+
+        for (size_t d = 0; d < DIRECTIONS_COUNT; ++d) {
+            const auto dir = static_cast<Direction>(d);
+            auto& dir_entries = entries[d];
+
+            // При совпадении точек побеждает дорога, объявленная на карте раньше
+            std::stable_sort(dir_entries.begin(), dir_entries.end(), [](const Entry& lhs, const Entry& rhs) {
+                return std::tie(lhs.boundary, lhs.cross_coord) < std::tie(rhs.boundary, rhs.cross_coord);
+            });
+            dir_entries.erase(std::unique(dir_entries.begin(), dir_entries.end(), [](const Entry& lhs, const Entry& rhs) {
+                return lhs.boundary == rhs.boundary && lhs.cross_coord == rhs.cross_coord;
+            }), dir_entries.end());
+
+            const auto dir_begin = static_cast<uint32_t>(crossings_.size());
+            for (const auto& entry : dir_entries) {
+                crossings_.push_back({entry.cross_coord, entry.corridor});
+            }
+
+            for (CorridorId id = 0; id < corridors_.size(); ++id) {
+                // Вдоль коридора продолжения нет: всё, что к нему примыкает на той же прямой, уже вошло в него
+                if (IsAlong(corridors_[id], dir)) {
+                    continue;
+                }
+
+                const Coord boundary = GetBoundary(corridors_[id], dir);
+                auto first = std::partition_point(dir_entries.begin(), dir_entries.end(), [boundary](const Entry& entry) {
+                    return entry.boundary < boundary;
+                });
+                auto last = std::partition_point(first, dir_entries.end(), [boundary](const Entry& entry) {
+                    return entry.boundary == boundary;
+                });
+                crossing_ranges_[GetSlot(id, dir)] = {dir_begin + static_cast<uint32_t>(first - dir_entries.begin()),
+                                                      dir_begin + static_cast<uint32_t>(last - dir_entries.begin())};
             }
         }
 
         //В качестве начальной дороги, выбираем любую, с нулевыми координатами.
-        starting_road_ = (point_to_right_road_.count({0,0})) ?
-                         point_to_right_road_.at({0,0}) : point_to_down_road_.at({0,0});
+        auto find_start = [this](bool horizontal) {
+            for (RoadId id = 0; id < roads_.size(); ++id) {
+                auto start = roads_[id].GetStart();
+                if (start.x == 0 && start.y == 0 && roads_[id].IsHorizontal() == horizontal) {
+                    return road_to_corridor_[id];
+                }
+            }
+            return NO_CORRIDOR;
+        };
+        starting_corridor_ = find_start(true);
+        if (starting_corridor_ == NO_CORRIDOR) {
+            starting_corridor_ = find_start(false);
+        }
+    }
+
+    RoadGraph::CorridorId RoadGraph::GetNextCorridor(CorridorId corridor, Direction dir, Coord cross_coord) const noexcept {
+        if (IsAlong(corridors_[corridor], dir)) {
+            return NO_CORRIDOR;
+        }
+
+        const auto range = crossing_ranges_[GetSlot(corridor, dir)];
+        auto first = crossings_.begin() + range.begin;
+        auto last = crossings_.begin() + range.end;
+        auto it = std::lower_bound(first, last, cross_coord, [](const Crossing& crossing, Coord coord) {
+            return crossing.cross_coord < coord;
+        });
+
+        return (it != last && it->cross_coord == cross_coord) ? it->corridor : NO_CORRIDOR;
+    }
+
+    bool RoadGraph::IsAlong(const Road& road, Direction dir) noexcept {
+        return (dir == Direction::LEFT || dir == Direction::RIGHT) == road.IsHorizontal();
+    }
+
+    Coord RoadGraph::GetBoundary(const Road& road, Direction dir) noexcept {
+        switch (dir) {
+            case Direction::LEFT:
+                return road.GetStart().x;
+            case Direction::RIGHT:
+                return road.GetEnd().x;
+            case Direction::UP:
+                return road.GetStart().y;
+            case Direction::DOWN:
+                return road.GetEnd().y;
+            case Direction::STOP:
+                break;
+        }
+        return 0;
+    }
+
+    //Определения методов класса GameSession
+    using namespace std::chrono_literals;
+    GameSession::GameSession(const Map* map, bool spawn_points_are_random, double period, double probability,
+                             collision_detector::Engine collision_engine,
+                             collision_detector::ParallelOptions collision_parallel)
+            : map_(map)
+            , loot_generator_(std::chrono::duration_cast<std::chrono::milliseconds>(period * 1ms), probability)
+            , spawn_points_are_random_(spawn_points_are_random)
+            , collision_engine_(collision_engine)
+            , collision_world_(collision_engine, collision_parallel)
+            , offices_count_(map->GetOffices().size())
+            , road_graph_(&map->GetRoadGraph())
+    {
+        if (road_graph_->GetStartingCorridor() == RoadGraph::NO_CORRIDOR) {
+            throw std::out_of_range("No road starts at (0, 0) on map "s + *map->GetId());
+        }
+
+        // Офисы статичны, поэтому добавляем их в мир один раз
+        for (const auto& office : map->GetOffices()) {
+            auto pos = office.GetPosition();
+            collision_world_.AddItem({{static_cast<double>(pos.x), static_cast<double>(pos.y)}, office_width_});
+        }
     }
 
     void GameSession::AddDog(Dog* dog) {
-        dogs_.push_back(dog);
+        Position pos;
+        RoadGraph::CorridorId corridor;
 
         if (spawn_points_are_random_) {
-            auto ptr_road = directed_ptr_roads_[GetRandomNumberFromRange(0, directed_ptr_roads_.size() - 1)];
-            dog_and_his_road_[dog] = ptr_road;
-
-            double x = GetRandomNumberFromRange(ptr_road->GetStart().x, ptr_road->GetEnd().x);
-            double y = GetRandomNumberFromRange(ptr_road->GetStart().y, ptr_road->GetEnd().y);
+            auto road_id = static_cast<RoadGraph::RoadId>(GetRandomNumberFromRange(0, road_graph_->GetRoadsCount() - 1));
+            corridor = road_graph_->GetCorridorOfRoad(road_id);
 
-            dog->SetPosition({x, y});
+            const Road& road = road_graph_->GetRoad(road_id);
+            pos.x = GetRandomNumberFromRange(road.GetStart().x, road.GetEnd().x);
+            pos.y = GetRandomNumberFromRange(road.GetStart().y, road.GetEnd().y);
         } else {
             //Все собаки появляются на одной дороге у которой одна из точек в нулевых координатах
-            dog_and_his_road_[dog] = starting_road_;
+            corridor = road_graph_->GetStartingCorridor();
         }
+
+        const size_t slot = dogs_.size();
+        dogs_state_.positions.push_back(pos);
+        dogs_state_.speeds.emplace_back();
+        dogs_state_.directions.push_back(Direction::UP);
+        dogs_state_.corridors.push_back(corridor);
+        dogs_state_.is_changed.push_back(false);
+        dogs_state_.MarkChanged(slot);
+        dog->BindState(&dogs_state_, slot);
+
+        dogs_.push_back(dog);
+        collision_world_.AddGatherer({{}, {}, dog_width_});
+
+        // Собака попадёт в снимок при ближайшей публикации: входы игроков публикуются в PublishChanges
+        // одним снимком на несколько запросов
+    }
+
+    void GameSession::PublishChanges() {
+        if (!dogs_state_.changed.empty()) {
+            PublishSnapshot();
+        }
+    }
+
+    void GameSession::PublishSnapshot() {
+        auto previous = snapshot_.load(std::memory_order_relaxed);
+
+        auto snapshot = std::make_shared<GameSessionSnapshot>();
+        snapshot->version = ++snapshot_version_;
+
+        // Собаки только добавляются в конец dogs_, поэтому слот собаки в прошлом снимке тот же.
+        // Неизменившиеся собаки переходят из прошлого снимка, изменившиеся копируются заново
+        snapshot->dogs.reserve(dogs_.size());
+        snapshot->dogs = previous->dogs;
+        snapshot->dogs.resize(dogs_.size());
+
+        std::vector<size_t> changed_dogs = std::move(dogs_state_.changed);
+        dogs_state_.changed.clear();
+        std::sort(changed_dogs.begin(), changed_dogs.end());
+        for (size_t slot : changed_dogs) {
+            dogs_state_.is_changed[slot] = false;
+
+            const Dog* dog = dogs_[slot];
+            snapshot->dogs[slot] = std::make_shared<const GameSessionSnapshot::DogState>(
+                    GameSessionSnapshot::DogState{dog->GetId(),
+                                                  std::string{dog->GetName()},
+                                                  dogs_state_.positions[slot],
+                                                  dogs_state_.speeds[slot],
+                                                  dogs_state_.directions[slot],
+                                                  dog->GetBackpackContents(),
+                                                  dog->GetScore()});
+        }
+
+        // Набор предметов меняется, только когда предметы появляются или их подбирают
+        const bool lost_objects_changed = history_.empty() || !removed_lost_objects_.empty()
+                                          || history_.back()->next_lost_object_id != lost_objects_id_counter;
+        snapshot->lost_objects = lost_objects_changed ? std::make_shared<const LostObjectsIdToLoot>(lost_objects_)
+                                                      : previous->lost_objects;
+
+        history_.push_back(std::make_shared<const GameSessionSnapshot::Change>(
+                GameSessionSnapshot::Change{snapshot->version,
+                                            std::move(changed_dogs),
+                                            lost_objects_id_counter,
+                                            std::move(removed_lost_objects_)}));
+        removed_lost_objects_.clear();
+        if (history_.size() > history_depth_) {
+            history_.pop_front();
+        }
+        snapshot->history.assign(history_.begin(), history_.end());
+
+        snapshot_.store(std::move(snapshot), std::memory_order_release);
     }
 
     void GameSession::GenerateLostObjects(double shift_time) {
@@ -95,73 +326,58 @@ namespace model {
             Loot loot;
             loot.type = GetRandomNumberFromRange(0, map_->GetAmountOfLootTypes() - 1);
 
-            auto ptr_road = directed_ptr_roads_[GetRandomNumberFromRange(0, directed_ptr_roads_.size() - 1)];
-            loot.pos.x = GetRandomNumberFromRange(ptr_road->GetStart().x, ptr_road->GetEnd().x);
-            loot.pos.y = GetRandomNumberFromRange(ptr_road->GetStart().y, ptr_road->GetEnd().y);
+            const Road& road = road_graph_->GetRoad(GetRandomNumberFromRange(0, road_graph_->GetRoadsCount() - 1));
+            loot.pos.x = GetRandomNumberFromRange(road.GetStart().x, road.GetEnd().x);
+            loot.pos.y = GetRandomNumberFromRange(road.GetStart().y, road.GetEnd().y);
 
-            lost_objects_[lost_objects_id_counter++] = loot;
+            AddLostObject(lost_objects_id_counter++, loot);
         }
     }
 
-    std::pair<GameSession::Items, GameSession::ItemsIdToLostObjectsId> GameSession::GetItemsAndItemsIdToLostObjectsId() {
-        Items items;
-        size_t items_id_counter = 0;
+    void GameSession::AddLostObject(size_t id, const Loot& loot) {
+        lost_objects_[id] = loot;
 
-        // Добавляем офисы, чтобы проверить на посещение собакой офиса
-        for(auto office : map_->GetOffices()) {
-            auto pos = office.GetPosition();
-            items.push_back({{static_cast<double>(pos.x), static_cast<double>(pos.y)}, 0.25});
-            ++items_id_counter;
-        }
-        // Нам неважно, какой конкретно офис посещает собака, поэтому запоминаем только лут
-        std::unordered_map<size_t , size_t> items_id_to_lost_objects_id;
+        size_t item_id = collision_world_.AddItem({{loot.pos.x, loot.pos.y}, loot_width_});
+        item_to_lost_object_.push_back(id);
+        lost_object_to_item_[id] = item_id;
+    }
 
-        for (auto [id, loot] : lost_objects_) {
-            auto pos = loot.pos;
-            items.push_back({{static_cast<double>(pos.x), static_cast<double>(pos.y)}, 0.});
+    void GameSession::RemoveLostObjectFromCollisionWorld(size_t id) {
+        size_t item_id = lost_object_to_item_.at(id);
+        size_t moved_item_id = collision_world_.RemoveItem(item_id);
 
-            items_id_to_lost_objects_id[items_id_counter++] = id;
+        // На место удалённого предмета переехал последний, переносим и его id лута
+        if (moved_item_id != item_id) {
+            size_t moved_id = item_to_lost_object_[moved_item_id - offices_count_];
+            item_to_lost_object_[item_id - offices_count_] = moved_id;
+            lost_object_to_item_[moved_id] = item_id;
         }
-
-        return std::make_pair(std::move(items), std::move(items_id_to_lost_objects_id));
+        item_to_lost_object_.pop_back();
+        lost_object_to_item_.erase(id);
     }
 
-    std::pair<GameSession::Gatherers, GameSession::GatherIdToDog> GameSession::GetGatherersAndGatherIdToDog(double shift_time) {
-        Gatherers gatherers;
-
-        std::unordered_map<size_t , Dog*> gather_id_to_dog;
-        size_t gather_id_counter = 0;
-
-        for (auto dog : dogs_) {
+    void GameSession::MoveDogsAndUpdateGatherers(double shift_time) {
+        for (size_t slot = 0; slot < dogs_.size(); ++slot) {
             // Устанавливаем стартовую позицию сборщику
-            auto start_pos = dog->GetPosition();
+            auto start_pos = dogs_state_.positions[slot];
 
             //Перемещаем собаку в конечную точку
-            SetTimeShiftForOneDog(shift_time, dog);
+            SetTimeShiftForOneDog(shift_time, slot);
 
             // Устанавливаем конечную позицию сборщика
-            auto end_pos = dog->GetPosition();
+            auto end_pos = dogs_state_.positions[slot];
 
-            gather_id_to_dog[gather_id_counter++] = dog;
-            gatherers.push_back({{start_pos.x, start_pos.y},{end_pos.x, end_pos.y},0.3});
+            collision_world_.SetGatherer(slot, {{start_pos.x, start_pos.y}, {end_pos.x, end_pos.y}, dog_width_});
         }
-
-        return std::make_pair(std::move(gatherers), std::move(gather_id_to_dog));
     }
 
     void GameSession::SetTimeShift(double shift_time) {
-        auto [gatherers, gather_id_to_dog] = GetGatherersAndGatherIdToDog(shift_time);
-
-        auto [items, items_id_to_lost_objects_id] = GetItemsAndItemsIdToLostObjectsId();
-
-        collision_detector::VectorItemGathererProvider provider(std::move(items), std::move(gatherers));
-
-        auto gather_events = collision_detector::FindGatherEvents(provider);
+        MoveDogsAndUpdateGatherers(shift_time);
 
-        for (auto& event : gather_events) {
-            auto dog = gather_id_to_dog[event.gatherer_id];
-            // Если id ивента нет в словаре, то обрабатываем ивент посещения собакой базы
-            if (!items_id_to_lost_objects_id.count(event.item_id)) {
+        for (auto& event : collision_world_.FindGatherEvents()) {
+            auto dog = dogs_[event.gatherer_id];
+            // Первые offices_count_ предметов - офисы, обрабатываем ивент посещения собакой базы
+            if (event.item_id < offices_count_) {
                 // Собака пришла на базу.
                 // Производим подсчёт очков.
                 for (auto [id, type] : dog->GetBackpackContents()) {
@@ -172,15 +388,25 @@ namespace model {
                 dog->EmptyTheBackpack();
             }
             // Если предмет есть на карте. Предмета может не быть, поскольку другая собака могла его уже забрать
-            else if (auto loot_id = items_id_to_lost_objects_id[event.item_id]; lost_objects_.count(loot_id)) {
+            else if (auto loot_id = item_to_lost_object_[event.item_id - offices_count_]; lost_objects_.count(loot_id)) {
                 // Добавляем в рюкзак собаки предмет
                 dog->AddToBackpack(loot_id, lost_objects_[loot_id].type);
                 // Удаляем с карты предмет, чтобы другая собака в радиусе предмета его не подобрала
                 lost_objects_.erase(loot_id);
+                // Из мира столкновений удаляем после обработки всех событий, чтобы не сбить индексы предметов
+                collected_lost_objects_.push_back(loot_id);
             }
         }
 
+        for (size_t loot_id : collected_lost_objects_) {
+            RemoveLostObjectFromCollisionWorld(loot_id);
+            removed_lost_objects_.push_back(loot_id);
+        }
+        collected_lost_objects_.clear();
+
         GenerateLostObjects(shift_time);
+
+        PublishSnapshot();
     }
 
     bool GameSession::CheckEqualityDouble(double lhs, double rhs) {
@@ -205,198 +431,85 @@ namespace model {
         return std::make_pair(RoundCoord(lhs), RoundCoord(rhs));
     }
 
-    void GameSession::MoveDogRight(double shift_time, Dog* dog) {
-        auto [dir, pos, speed] = dog->GetMovementParameters();
-
-        double distance = shift_time * speed.horizontal;
-
-        //Как-бы рекурсивно проходим все дороги по которым пройдет собака
-        std::stack<const Road*> st;
-        st.push(dog_and_his_road_.at(dog));
-
-        while (!st.empty()) {
-            st.pop();
-
-            double road_edge_coordinate = dog_and_his_road_.at(dog)->GetEnd().x + distance_from_road_axis_to_boundary_;
-
-            //Если дистанция перемещения не выходит из площади текущей дороги
-            if (LessOrEqual(distance + pos.x, road_edge_coordinate)) {
-                dog->SetPosition({distance + pos.x, pos.y});
-
-                if (CheckEqualityDouble(distance + pos.x, road_edge_coordinate)) {
-                    dog->SetMovementParameters(Direction::STOP, map_->GetDogSpeed());
-                }
-
-                return;
-            }
-
-            //Иначе доходим до конца дороги, преодолев необходимую дистанцию
-            distance -= road_edge_coordinate - pos.x;
-            pos.x = road_edge_coordinate;
-
-            //Если у нас больше нет дорог справа, а дистанция для преодоления осталась, то мы уперлись в границу карты
-            auto dog_coord = RoundCoordinates(pos.x, pos.y);
-            if (!point_to_right_road_.count(dog_coord)) {
-                dog->SetPosition({pos.x, pos.y});
-                dog->SetMovementParameters(Direction::STOP, map_->GetDogSpeed());
-                return;
-            }
-            //Добавляем в стек дорогу, на которую можем перейти и продолжаем движение
-            st.push(point_to_right_road_.at(dog_coord));
-            dog_and_his_road_[dog] = st.top();
-        }
-    }
-
-    void GameSession::MoveDogLeft(double shift_time, Dog* dog) {
-        auto [dir, pos, speed] = dog->GetMovementParameters();
+    template <Direction dir>
+    void GameSession::MoveDog(const RoadGraph& road_graph, double shift_time,
+                              Position& pos, Speed& speed, RoadGraph::CorridorId& corridor_id) {
+        static_assert(dir != Direction::STOP);
+        constexpr bool horizontal = (dir == Direction::LEFT || dir == Direction::RIGHT);
+        // Двигаемся ли в сторону увеличения координаты
+        constexpr bool forward = (dir == Direction::RIGHT || dir == Direction::DOWN);
 
-        double distance = shift_time * speed.horizontal;
+        //Координата собаки вдоль направления движения и поперёк него
+        double& coord = horizontal ? pos.x : pos.y;
+        const double cross_coord = horizontal ? pos.y : pos.x;
 
-        //Как-бы рекурсивно проходим все дороги по которым пройдет собака
-        std::stack<const Road*> st;
-        st.push(dog_and_his_road_.at(dog));
+        double distance = shift_time * (horizontal ? speed.horizontal : speed.vertical);
 
-        while (!st.empty()) {
-            st.pop();
+        //Проходим все коридоры по которым пройдет собака
+        while (true) {
+            const Road& corridor = road_graph.GetCorridor(corridor_id);
+            const Point boundary = forward ? corridor.GetEnd() : corridor.GetStart();
+            const double road_edge_coordinate = (horizontal ? boundary.x : boundary.y)
+                                                + (forward ? distance_from_road_axis_to_boundary_ : -distance_from_road_axis_to_boundary_);
 
-            double road_edge_coordinate = dog_and_his_road_.at(dog)->GetStart().x - distance_from_road_axis_to_boundary_;
+            //Если дистанция перемещения не выходит из площади текущего коридора
+            if (forward ? LessOrEqual(distance + coord, road_edge_coordinate)
+                        : LessOrEqual(road_edge_coordinate, distance + coord)) {
+                coord += distance;
 
-            //Если дистанция перемещения не выходит из площади текущей дороги
-            if (LessOrEqual(road_edge_coordinate, distance + pos.x)) {
-                dog->SetPosition({distance + pos.x, pos.y});
-
-                if (CheckEqualityDouble(distance + pos.x, road_edge_coordinate)) {
-                    dog->SetMovementParameters(Direction::STOP, map_->GetDogSpeed());
+                if (CheckEqualityDouble(coord, road_edge_coordinate)) {
+                    speed = {};
                 }
 
                 return;
             }
 
-            //Иначе доходим до конца дороги, преодолев необходимую дистанцию
-            distance -= road_edge_coordinate - pos.x;
-            pos.x = road_edge_coordinate;
-
-            //Если у нас больше нет дорог слева, а дистанция для преодоления осталась, то мы уперлись в границу карты
-            auto dog_coord = RoundCoordinates(pos.x, pos.y);
-            if (!point_to_left_road_.count(dog_coord)) {
-                dog->SetPosition({pos.x, pos.y});
-                dog->SetMovementParameters(Direction::STOP, map_->GetDogSpeed());
-                return;
-            }
-            //Добавляем в стек дорогу, на которую можем перейти и продолжаем движение
-            st.push(point_to_left_road_.at(dog_coord));
-            dog_and_his_road_[dog] = st.top();
-        }
-    }
-
-    void GameSession::MoveDogUp(double shift_time, Dog* dog) {
-        auto [dir, pos, speed] = dog->GetMovementParameters();
-
-        double distance = shift_time * speed.vertical;
-
-        //Как-бы рекурсивно проходим все дороги по которым пройдет собака
-        std::stack<const Road*> st;
-        st.push(dog_and_his_road_.at(dog));
-
-        while (!st.empty()) {
-            st.pop();
-
-            double road_edge_coordinate = dog_and_his_road_.at(dog)->GetStart().y - distance_from_road_axis_to_boundary_;
-
-            //Если дистанция перемещения не выходит из площади текущей дороги
-            if (LessOrEqual(road_edge_coordinate, distance + pos.y)) {
-                dog->SetPosition({pos.x, distance + pos.y});
-
-                if (CheckEqualityDouble(distance + pos.y, road_edge_coordinate)) {
-                    dog->SetMovementParameters(Direction::STOP, map_->GetDogSpeed());
-                }
-
-                return;
-            }
-
-            //Иначе доходим до конца дороги, преодолев необходимую дистанцию
-            distance -= road_edge_coordinate - pos.y;
-            pos.y = road_edge_coordinate;
+            //Иначе доходим до конца коридора, преодолев необходимую дистанцию
+            distance -= road_edge_coordinate - coord;
+            coord = road_edge_coordinate;
 
             //Если у нас больше нет дорог, а дистанция для преодоления осталась, то мы уперлись в границу карты
-            auto dog_coord = RoundCoordinates(pos.x, pos.y);
-            if (!point_to_up_road_.count(dog_coord)) {
-                dog->SetPosition({pos.x, pos.y});
-                dog->SetMovementParameters(Direction::STOP, map_->GetDogSpeed());
+            auto next_corridor = road_graph.GetNextCorridor(corridor_id, dir, RoundCoord(cross_coord));
+            if (next_corridor == RoadGraph::NO_CORRIDOR) {
+                speed = {};
                 return;
             }
-            //Добавляем в стек дорогу, на которую можем перейти и продолжаем движение
-            st.push(point_to_up_road_.at(dog_coord));
-            dog_and_his_road_[dog] = st.top();
+            //Переходим на следующий коридор и продолжаем движение
+            corridor_id = next_corridor;
         }
     }
 
-    void GameSession::MoveDogDown(double shift_time, Dog* dog) {
-        auto [dir, pos, speed] = dog->GetMovementParameters();
-
-        double distance = shift_time * speed.vertical;
-
-        //Как-бы рекурсивно проходим все дороги по которым пройдет собака
-        std::stack<const Road*> st;
-        st.push(dog_and_his_road_.at(dog));
-
-        while (!st.empty()) {
-            st.pop();
-
-            double road_edge_coordinate = dog_and_his_road_.at(dog)->GetEnd().y + distance_from_road_axis_to_boundary_;
-
-            //Если дистанция перемещения не выходит из площади текущей дороги
-            if (LessOrEqual(distance + pos.y, road_edge_coordinate)) {
-                dog->SetPosition({pos.x, distance + pos.y});
-
-                if (CheckEqualityDouble(distance + pos.y, road_edge_coordinate)) {
-                    dog->SetMovementParameters(Direction::STOP, map_->GetDogSpeed());
-                }
-
-                return;
-            }
-
-            //Иначе доходим до конца дороги, преодолев необходимую дистанцию
-            distance -= road_edge_coordinate - pos.y;
-            pos.y = road_edge_coordinate;
-
-            //Если у нас больше нет дорог справа, а дистанция для преодоления осталась, то мы уперлись в границу карты
-            auto dog_coord = RoundCoordinates(pos.x, pos.y);
-            if (!point_to_down_road_.count(dog_coord)) {
-                dog->SetPosition({pos.x, pos.y});
-                dog->SetMovementParameters(Direction::STOP, map_->GetDogSpeed());
-                return;
-            }
-            //Добавляем в стек дорогу, на которую можем перейти и продолжаем движение
-            st.push(point_to_down_road_.at(dog_coord));
-            dog_and_his_road_[dog] = st.top();
-        }
-    }
-
-    size_t GameSession::PointHasher::operator() (const std::pair<int, int>& value) const {
-        size_t h_x = hasher_(value.first);
-        size_t h_y = hasher_(value.second);
-
-        return h_x + h_y * 1000000007; // Где литерал - это выбранная константа, необходима для уменьшения коллизий
-    }
-
-    void GameSession::SetTimeShiftForOneDog(double shift_time, Dog* dog) {
-        switch (dog->GetDirection()) {
+    void GameSession::MoveDog(const RoadGraph& road_graph, double shift_time, Direction dir,
+                              Position& pos, Speed& speed, RoadGraph::CorridorId& corridor_id) {
+        switch (dir) {
             case Direction::RIGHT:
-                MoveDogRight(shift_time, dog);
+                MoveDog<Direction::RIGHT>(road_graph, shift_time, pos, speed, corridor_id);
                 break;
             case Direction::LEFT:
-                MoveDogLeft(shift_time, dog);
+                MoveDog<Direction::LEFT>(road_graph, shift_time, pos, speed, corridor_id);
                 break;
             case Direction::UP:
-                MoveDogUp(shift_time, dog);
+                MoveDog<Direction::UP>(road_graph, shift_time, pos, speed, corridor_id);
                 break;
             case Direction::DOWN:
-                MoveDogDown(shift_time, dog);
+                MoveDog<Direction::DOWN>(road_graph, shift_time, pos, speed, corridor_id);
+                break;
+            case Direction::STOP:
                 break;
         }
     }
 
+    void GameSession::SetTimeShiftForOneDog(double shift_time, size_t slot) {
+        // Собака с нулевой скоростью остаётся на месте, остальные сдвигаются или останавливаются
+        if (dogs_state_.speeds[slot] == Speed{}) {
+            return;
+        }
+        dogs_state_.MarkChanged(slot);
+
+        MoveDog(*road_graph_, shift_time, dogs_state_.directions[slot],
+                dogs_state_.positions[slot], dogs_state_.speeds[slot], dogs_state_.corridors[slot]);
+    }
+
     int GameSession::GetRandomNumberFromRange(int min, int max) {
         std::random_device random_device_;
 
@@ -408,19 +521,32 @@ namespace model {
     //Определения методов класса Players
 
     std::pair<Player::Token, unsigned > Players::AddPlayer(std::string&& name, GameSession* session) {
-        players_.emplace_back(Player{std::move(name), id_, session, Player::Token{GetPlayerToken()}});
+        Player* player;
+        unsigned id;
+        {
+            std::unique_lock lock{mutex_};
+            id = id_++;
+            // Элементы deque не переезжают при добавлении, поэтому указатель на игрока остаётся действительным
+            player = &players_.emplace_back(Player{std::move(name), id, session, Player::Token{GetPlayerToken()}});
+        }
 
-        session->AddDog(players_.back().GetDog());
-        id_to_player_.emplace(id_, &players_.back());
+        // Сессия публикует собаку, пока поиск игроков других карт не ждёт блокировку.
+        // Игрока ещё нельзя найти ни по токену, ни по собаке, поэтому к нему никто не обращается
+        session->AddDog(player->GetDog());
 
-        token_to_player_.emplace(players_.back().GetToken(), &players_.back());
+        std::unique_lock lock{mutex_};
+        id_to_player_.emplace(id, player);
 
-        dog_id_and_map_id_to_player_.emplace(std::make_pair(id_, session->GetMap()->GetId()), &players_.back());
+        token_to_player_.emplace(player->GetToken(), player);
 
-        return std::make_pair(players_.back().GetToken(), id_++);
+        dog_id_and_map_id_to_player_.emplace(std::make_pair(id, session->GetMap()->GetId()), player);
+
+        return std::make_pair(player->GetToken(), id);
     }
 
     const Player* Players::FindByToken(const Player::Token& token) const {
+        std::shared_lock lock{mutex_};
+
         if (token_to_player_.count(token)) {
             return token_to_player_.at(token);
         }
@@ -428,6 +554,8 @@ namespace model {
     }
 
     Player* Players::FindByToken(const Player::Token& token) {
+        std::shared_lock lock{mutex_};
+
         if (token_to_player_.count(token)) {
             return token_to_player_.at(token);
         }
@@ -435,6 +563,8 @@ namespace model {
     }
 
     const Player* Players::FindByDogIdAndMapId(const std::pair<unsigned, Map::Id>& value) const {
+        std::shared_lock lock{mutex_};
+
         if (dog_id_and_map_id_to_player_.count(value)) {
             return dog_id_and_map_id_to_player_.at(value);
         }
@@ -495,16 +625,45 @@ namespace model {
         if (!map) {
             return std::nullopt;
         }
-        //На данный момент, на каждую карту, одна сессия
-        if (!map_id_to_game_sessions_.count(id)) {
-            game_sessions_.emplace_back(GameSession{map,
-                                                    spawn_points_are_random_,
-                                                    period_,
-                                                    probability_});
-            map_id_to_game_sessions_.emplace(id, &game_sessions_.back());
+        GameSession* session;
+        {
+            std::lock_guard lock{sessions_mutex_};
+            //На данный момент, на каждую карту, одна сессия
+            if (!map_id_to_game_sessions_.count(id)) {
+                // Собаки ссылаются на массивы состояния внутри сессии, поэтому создаём её сразу на месте
+                game_sessions_.emplace_back(map,
+                                            spawn_points_are_random_,
+                                            period_,
+                                            probability_,
+                                            collision_engine_,
+                                            collision_parallel_);
+                map_id_to_game_sessions_.emplace(id, &game_sessions_.back());
+            }
+            session = map_id_to_game_sessions_.at(id);
         }
 
-        return players_.AddPlayer(std::move(name), map_id_to_game_sessions_.at(id)/*, id*/);
+        return players_.AddPlayer(std::move(name), session);
+    }
+
+    GameSession* Game::FindGameSession(const Map::Id& id) {
+        std::lock_guard lock{sessions_mutex_};
+
+        if (auto it = map_id_to_game_sessions_.find(id); it != map_id_to_game_sessions_.end()) {
+            return it->second;
+        }
+        return nullptr;
+    }
+
+    std::vector<GameSession*> Game::GetGameSessions() {
+        std::lock_guard lock{sessions_mutex_};
+
+        std::vector<GameSession*> sessions;
+        sessions.reserve(game_sessions_.size());
+        for (auto& session : game_sessions_) {
+            sessions.push_back(&session);
+        }
+
+        return sessions;
     }
 
     void Game::SetDefaultDogSpeed(double dog_speed) {
@@ -523,10 +682,12 @@ namespace model {
         return default_bag_capacity_;
     }
 
-    void Game::SetTimeShift(double shift_time) {
-        for (auto& gs : game_sessions_) {
-            gs.SetTimeShift(shift_time);
-        }
+    void Game::SetCollisionEngine(collision_detector::Engine collision_engine) {
+        collision_engine_ = collision_engine;
+    }
+
+    void Game::SetCollisionParallelOptions(collision_detector::ParallelOptions collision_parallel) {
+        collision_parallel_ = collision_parallel;
     }
 
     void Game::SetSpawnPointsRandom(bool spawn_points_are_random) {
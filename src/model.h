@@ -2,7 +2,7 @@
 
 #include "tagged.h"
 #include "loot_generator.h"
-#include "collision_detector.h"
+#include "collision_world.h"
 
 #include <string>
 #include <unordered_map>
@@ -11,7 +11,12 @@
 #include <random>
 #include <optional>
 #include <deque>
-#include <stack>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <limits>
+#include <cstdint>
 #include <tuple>
 
 namespace model {
@@ -82,6 +87,86 @@ namespace model {
         Point end_;
     };
 
+    enum class Direction {
+        LEFT,
+        RIGHT,
+        UP,
+        DOWN,
+        STOP
+    };
+
+    // Индекс связей между дорогами карты. Строится один раз при загрузке карты и общий для всех её игровых сессий.
+    // Соединённые или перекрывающиеся дороги одной прямой объединяются в коридоры, по которым перемещаются собаки.
+    // Дороги и коридоры хранятся в виде, при котором стартовая координата всегда меньше конечной.
+    class RoadGraph {
+    public:
+        using RoadId = uint32_t;
+        using CorridorId = uint32_t;
+        constexpr static CorridorId NO_CORRIDOR = std::numeric_limits<CorridorId>::max();
+
+        RoadGraph() = default;
+
+        explicit RoadGraph(const std::vector<Road>& roads);
+
+        // Дороги нумеруются в порядке карты
+        const Road& GetRoad(RoadId id) const noexcept {
+            return roads_[id];
+        }
+
+        size_t GetRoadsCount() const noexcept {
+            return roads_.size();
+        }
+
+        CorridorId GetCorridorOfRoad(RoadId id) const noexcept {
+            return road_to_corridor_[id];
+        }
+
+        const Road& GetCorridor(CorridorId id) const noexcept {
+            return corridors_[id];
+        }
+
+        // Коридор, с которого начинают движение собаки при неслучайном спавне, либо NO_CORRIDOR
+        CorridorId GetStartingCorridor() const noexcept {
+            return starting_corridor_;
+        }
+
+        // Коридор, на который собака переходит, выйдя за границу коридора corridor в направлении dir.
+        // cross_coord - округлённая координата собаки поперёк направления движения. Если коридора нет, возвращает NO_CORRIDOR.
+        CorridorId GetNextCorridor(CorridorId corridor, Direction dir, Coord cross_coord) const noexcept;
+
+    private:
+        constexpr static size_t DIRECTIONS_COUNT = 4;
+
+        struct Crossing {
+            Coord cross_coord;
+            CorridorId corridor;
+        };
+
+        struct CrossingsRange {
+            uint32_t begin = 0;
+            uint32_t end = 0;
+        };
+
+        static bool IsAlong(const Road& road, Direction dir) noexcept;
+
+        // Координата границы дороги вдоль направления dir, за которой ищется следующий коридор
+        static Coord GetBoundary(const Road& road, Direction dir) noexcept;
+
+        static size_t GetSlot(CorridorId corridor, Direction dir) noexcept {
+            return corridor * DIRECTIONS_COUNT + static_cast<size_t>(dir);
+        }
+
+        std::vector<Road> roads_;
+        std::vector<CorridorId> road_to_corridor_;
+        std::vector<Road> corridors_;
+        CorridorId starting_corridor_ = NO_CORRIDOR;
+
+        // Для коридора, идущего поперёк направления, - отсортированные по cross_coord коридоры,
+        // в которые можно свернуть с его оси: crossings_[crossing_ranges_[GetSlot(corridor, dir)]]
+        std::vector<CrossingsRange> crossing_ranges_;
+        std::vector<Crossing> crossings_;
+    };
+
     class Building {
     public:
         explicit Building(Rectangle bounds) noexcept
@@ -136,8 +221,8 @@ namespace model {
                 : id_(std::move(id))
                 , name_(std::move(name))
                 , dog_speed_(dog_speed)
-                , loot_type_to_value_(std::move(loot_type_to_value))
-                , bag_capacity_(bag_capacity) {
+                , bag_capacity_(bag_capacity)
+                , loot_type_to_value_(std::move(loot_type_to_value)) {
         }
 
         const Id& GetId() const noexcept {
@@ -156,6 +241,10 @@ namespace model {
             return roads_;
         }
 
+        const RoadGraph& GetRoadGraph() const noexcept {
+            return road_graph_;
+        }
+
         const Offices& GetOffices() const noexcept {
             return offices_;
         }
@@ -172,6 +261,10 @@ namespace model {
             roads_.emplace_back(road);
         }
 
+        void SetRoadGraph(RoadGraph&& road_graph) noexcept {
+            road_graph_ = std::move(road_graph);
+        }
+
         void AddBuilding(const Building& building) {
             buildings_.emplace_back(building);
         }
@@ -208,6 +301,7 @@ namespace model {
         std::string name_;
 
         Roads roads_;
+        RoadGraph road_graph_;
         Buildings buildings_;
 
         double dog_speed_;
@@ -223,21 +317,39 @@ namespace model {
     struct Position {
         double x = 0.;
         double y = 0.;
+
+        bool operator==(const Position&) const = default;
     };
 
     struct Speed {
         double horizontal = 0.;
         double vertical = 0.;
+
+        bool operator==(const Speed&) const = default;
     };
 
-    enum class Direction {
-        LEFT,
-        RIGHT,
-        UP,
-        DOWN,
-        STOP
+    // Часто изменяемое при симуляции состояние собак игровой сессии, разложенное по массивам.
+    // Индекс в каждом массиве - слот собаки в сессии.
+    struct DogsState {
+        std::vector<Position> positions;
+        std::vector<Speed> speeds;
+        std::vector<Direction> directions;
+        std::vector<RoadGraph::CorridorId> corridors;
+
+        // Слоты собак, изменившихся после публикации прошлого снимка, и отметки о них по слотам.
+        // В снимок заново копируются только эти собаки
+        std::vector<size_t> changed;
+        std::vector<char> is_changed;
+
+        void MarkChanged(size_t slot) {
+            if (!is_changed[slot]) {
+                is_changed[slot] = true;
+                changed.push_back(slot);
+            }
+        }
     };
 
+    // Собака хранит имя, рюкзак и очки, а положение, скорость и направление читает из слота своей игровой сессии
     class Dog {
     public:
         using MovementParameters = std::tuple<Direction, Position, Speed>;
@@ -257,29 +369,40 @@ namespace model {
         }
 
         MovementParameters GetMovementParameters() const {
-            return std::make_tuple(dir_, pos_, speed_);
+            return std::make_tuple(state_->directions[slot_], state_->positions[slot_], state_->speeds[slot_]);
         }
 
-        Direction GetDirection() {
-            return dir_;
+        Direction GetDirection() const {
+            return state_->directions[slot_];
         }
 
         Position GetPosition() const {
-            return pos_;
+            return state_->positions[slot_];
         }
 
         void SetMovementParameters(Direction dir, double default_dog_speed);
 
         void SetPosition(Position pos) {
-            pos_ = pos;
+            state_->positions[slot_] = pos;
+            state_->MarkChanged(slot_);
+        }
+
+        // Привязывает собаку к слоту в массивах состояния игровой сессии
+        void BindState(DogsState* state, size_t slot) {
+            state_ = state;
+            slot_ = slot;
         }
 
         void AddToBackpack(size_t loot_id, size_t loot_type) {
             bag_.emplace_back(std::make_pair(loot_id, loot_type));
+            state_->MarkChanged(slot_);
         }
 
         void EmptyTheBackpack() {
-            bag_.clear();
+            if (!bag_.empty()) {
+                bag_.clear();
+                state_->MarkChanged(slot_);
+            }
         }
 
         const LootsIdAndType& GetBackpackContents() const {
@@ -287,7 +410,10 @@ namespace model {
         }
 
         void AddToTheScore(unsigned value) {
-            score += value;
+            if (value) {
+                score += value;
+                state_->MarkChanged(slot_);
+            }
         }
 
         unsigned GetScore() const {
@@ -298,9 +424,8 @@ namespace model {
         const std::string name_;
         const unsigned id_;
 
-        Direction dir_ = Direction::UP;
-        Position pos_;
-        Speed speed_;
+        DogsState* state_ = nullptr;
+        size_t slot_ = 0;
         unsigned score = 0;
 
         LootsIdAndType bag_;
@@ -312,11 +437,51 @@ namespace model {
         Position pos;
     };
 
+    // Неизменяемый снимок состояния игровой сессии на момент последнего изменения.
+    // Сессия публикует новый снимок целиком, поэтому читатели видят согласованное состояние без блокировок.
+    // Состояние собаки, не изменившейся с прошлого снимка, и неизменившийся набор предметов
+    // переходят в новый снимок без копирования.
+    struct GameSessionSnapshot {
+        struct DogState {
+            unsigned id;
+            std::string name;
+            Position pos;
+            Speed speed;
+            Direction dir;
+            Dog::LootsIdAndType bag;
+            unsigned score;
+        };
+
+        using LostObjects = std::unordered_map<size_t, Loot>;
+
+        // Изменения сессии в одной версии снимка
+        struct Change {
+            uint64_t version;
+            // Слоты собак, изменившихся в этой версии, по возрастанию
+            std::vector<size_t> changed_dogs;
+            // Предметы, появившиеся после этой версии, получают id не меньше этого
+            size_t next_lost_object_id;
+            // Предметы, подобранные собаками в этой версии
+            std::vector<size_t> removed_lost_objects;
+        };
+
+        // Растёт с каждым опубликованным снимком сессии
+        uint64_t version = 0;
+        // По слотам собак в сессии
+        std::vector<std::shared_ptr<const DogState>> dogs;
+        // Предметы на карте не изменяются, а только появляются и исчезают
+        std::shared_ptr<const LostObjects> lost_objects = std::make_shared<const LostObjects>();
+        // Изменения за последние версии подряд, от старых к новым. Последняя - версия этого снимка
+        std::vector<std::shared_ptr<const Change>> history;
+    };
+
     class GameSession {
     public:
         using LostObjectsIdToLoot = std::unordered_map<size_t, Loot>;
 
-        GameSession(const Map* map, bool spawn_points_are_random, double period, double probability);
+        GameSession(const Map* map, bool spawn_points_are_random, double period, double probability,
+                    collision_detector::Engine collision_engine = collision_detector::Engine::BRUTE_FORCE,
+                    collision_detector::ParallelOptions collision_parallel = {});
 
         void AddDog(Dog* dog);
 
@@ -330,6 +495,10 @@ namespace model {
 
         void SetTimeShift(double shift_time);
 
+        // Публикует снимок, если собаки изменились после публикации прошлого: вошли в сессию
+        // или получили новые направление и скорость. Вызывается там же, где выполняется тик сессии
+        void PublishChanges();
+
         static bool CheckEqualityDouble(double lhs, double rhs);
 
         static bool LessOrEqual(double lhs, double rhs);
@@ -338,16 +507,21 @@ namespace model {
 
         static std::pair<int, int> RoundCoordinates(double lhs, double rhs);
 
+        // Перемещает собаку по коридорам road_graph за время shift_time в направлении dir.
+        // Упёршись в границу дороги, собака останавливается: скорость обнуляется, направление сохраняется
+        static void MoveDog(const RoadGraph& road_graph, double shift_time, Direction dir,
+                            Position& pos, Speed& speed, RoadGraph::CorridorId& corridor_id);
+
         const LostObjectsIdToLoot& GetLostObjects() const {
             return lost_objects_;
         }
-    private:
-        using Items = std::vector<collision_detector::Item>;
-        using Gatherers = std::vector<collision_detector::Gatherer>;
-
-        using ItemsIdToLostObjectsId = std::unordered_map<size_t , size_t>;
-        using GatherIdToDog = std::unordered_map<size_t , Dog*>;
 
+        // Последний опубликованный снимок. Может вызываться из любого потока.
+        // Снимок публикуется в конце каждого тика и в PublishChanges после входа и действий игроков.
+        std::shared_ptr<const GameSessionSnapshot> GetSnapshot() const {
+            return snapshot_.load(std::memory_order_acquire);
+        }
+    private:
         const Map* map_;
         std::vector<Dog*> dogs_;
 
@@ -358,38 +532,53 @@ namespace model {
 
         bool spawn_points_are_random_;
 
+        collision_detector::Engine collision_engine_;
+
         constexpr static double distance_from_road_axis_to_boundary_ = 0.4;
 
-        std::deque<Road> directed_roads_;
-        std::vector<const Road*> directed_ptr_roads_;
-        std::unordered_map<const Dog*, const Road*> dog_and_his_road_;
-        const Road* starting_road_;
+        constexpr static double office_width_ = 0.25;
+        constexpr static double loot_width_ = 0.;
+        constexpr static double dog_width_ = 0.3;
 
-        struct PointHasher {
-            size_t operator() (const std::pair<int, int>& value) const;
-        private:
-            std::hash<int> hasher_;
-        };
+        // Офисы лежат в начале списка предметов и никогда не удаляются, за ними идёт лут.
+        // Индекс сборщика совпадает с индексом собаки в dogs_.
+        collision_detector::CollisionWorld collision_world_;
+        size_t offices_count_;
+        // Для каждого предмета-лута (индекс предмета минус offices_count_) хранит id лута
+        std::vector<size_t> item_to_lost_object_;
+        std::unordered_map<size_t, size_t> lost_object_to_item_;
+        // Лут, подобранный за текущий тик. Удаляется из collision_world_ после обработки всех событий.
+        std::vector<size_t> collected_lost_objects_;
+
+        // Граф дорог карты и состояние собак для симуляции. Слот собаки совпадает с её индексом в dogs_.
+        const RoadGraph* road_graph_;
+        DogsState dogs_state_;
+
+        std::atomic<std::shared_ptr<const GameSessionSnapshot>> snapshot_{std::make_shared<const GameSessionSnapshot>()};
+        uint64_t snapshot_version_ = 0;
 
-        //Таблица позиций от которых условно начинаются и заканчиваются дороги
-        std::unordered_map<std::pair<int, int>, const Road*, PointHasher> point_to_right_road_;
-        std::unordered_map<std::pair<int, int>, const Road*, PointHasher> point_to_left_road_;
-        std::unordered_map<std::pair<int, int>, const Road*, PointHasher> point_to_up_road_;
-        std::unordered_map<std::pair<int, int>, const Road*, PointHasher> point_to_down_road_;
+        // Сколько последних версий хранит история изменений в снимке
+        constexpr static size_t history_depth_ = 128;
+        std::deque<std::shared_ptr<const GameSessionSnapshot::Change>> history_;
+        // Предметы, подобранные с момента публикации прошлого снимка
+        std::vector<size_t> removed_lost_objects_;
 
-        std::pair<Items, ItemsIdToLostObjectsId> GetItemsAndItemsIdToLostObjectsId();
-        // Так же, данная функция вызывает перемещение собак по карте
-        std::pair<Gatherers, GatherIdToDog> GetGatherersAndGatherIdToDog(double shift_time);
+        // Публикует снимок текущего состояния
+        void PublishSnapshot();
 
-        void SetTimeShiftForOneDog(double shift_time, Dog* dog);
+        // Перемещает собак по карте и записывает их перемещения в сборщики collision_world_
+        void MoveDogsAndUpdateGatherers(double shift_time);
 
-        void MoveDogRight(double shift_time, Dog* dog);
+        void AddLostObject(size_t id, const Loot& loot);
 
-        void MoveDogLeft(double shift_time, Dog* dog);
+        void RemoveLostObjectFromCollisionWorld(size_t id);
 
-        void MoveDogUp(double shift_time, Dog* dog);
+        void SetTimeShiftForOneDog(double shift_time, size_t slot);
 
-        void MoveDogDown(double shift_time, Dog* dog);
+        // Перемещает собаку в направлении dir. Ось и знак движения известны на этапе компиляции.
+        template <Direction dir>
+        static void MoveDog(const RoadGraph& road_graph, double shift_time,
+                            Position& pos, Speed& speed, RoadGraph::CorridorId& corridor_id);
 
         int GetRandomNumberFromRange(int min, int max);
 
@@ -421,18 +610,26 @@ namespace model {
             return session_;
         }
 
+        GameSession* GetGameSession() {
+            return session_;
+        }
+
+        // Вызывается там же, где выполняется тик сессии игрока. Новые направление и скорость
+        // попадут в снимок сессии при ближайшем вызове GameSession::PublishChanges или в конце тика
         void SetDogMovementParameters(Direction dir) {
             dog_.SetMovementParameters(dir, session_->GetMap()->GetDogSpeed());
         }
 
     private:
         Dog dog_;
-        const GameSession* session_;
+        GameSession* session_;
         const Token token_;
     };
 
+    // Реестр игроков. Поиск игроков может выполняться из любого потока одновременно с добавлением.
     class Players {
     public:
+        // Добавляет собаку игрока в session, поэтому вызывается там же, где выполняется тик этой сессии
         std::pair<Player::Token, unsigned > AddPlayer(std::string&& name, GameSession* session);
 
         const Player* FindByToken(const Player::Token& token) const;
@@ -455,6 +652,8 @@ namespace model {
         using DogIdAndMapIdToPlayer = std::unordered_map<std::pair<unsigned, Map::Id>, Player*, DogIdAndMapIdHasher>;
         using PlayerToGameSession = std::unordered_map<Player*, GameSession*>;
 
+        mutable std::shared_mutex mutex_;
+
         unsigned id_ = 0u;
 
         std::deque<Player> players_;
@@ -477,7 +676,10 @@ namespace model {
                 throw std::invalid_argument("Map with id "s + *map.GetId() + " already exists"s);
             } else {
                 try {
+                    // Граф дорог строится один раз на карту и используется всеми её игровыми сессиями
+                    RoadGraph road_graph{map.GetRoads()};
                     maps_.emplace_back(std::forward<Arg>(map));
+                    maps_.back().SetRoadGraph(std::move(road_graph));
                 } catch (...) {
                     map_id_to_index_.erase(it);
                     throw;
@@ -495,14 +697,20 @@ namespace model {
 
         Player* FindPlayer(const Player::Token& token);
 
+        // Добавляет игрока в сессию карты id, при необходимости создавая её. Вызовы для разных карт могут идти
+        // параллельно, а вызовы для одной карты должны быть упорядочены с тиками её сессии.
         std::optional<std::pair<Player::Token, unsigned >> AddPlayer(std::string&& name, Map::Id&& id);
 
+        // Созданные на данный момент игровые сессии
+        std::vector<GameSession*> GetGameSessions();
+
+        // Игровая сессия карты id, nullptr - если на карту ещё никто не входил
+        GameSession* FindGameSession(const Map::Id& id);
+
         void SetDefaultDogSpeed(double dog_speed);
 
         double GetDefaultDogSpeed();
 
-        void SetTimeShift(double shift_time);
-
         void SetSpawnPointsRandom(bool spawn_points_are_random);
 
         void SetLootGeneratorConfig(double period, double probability);
@@ -511,6 +719,10 @@ namespace model {
 
         unsigned GetDefaultBagCapacity();
 
+        void SetCollisionEngine(collision_detector::Engine collision_engine);
+
+        void SetCollisionParallelOptions(collision_detector::ParallelOptions collision_parallel);
+
         using MapIdHasher = util::TaggedHasher<Map::Id>;
     private:
         using MapIdToIndex = std::unordered_map<Map::Id, size_t, MapIdHasher>;
@@ -524,7 +736,13 @@ namespace model {
 
         unsigned default_bag_capacity_ = 3;
 
+        collision_detector::Engine collision_engine_ = collision_detector::Engine::BRUTE_FORCE;
+        collision_detector::ParallelOptions collision_parallel_;
+
         std::vector<Map> maps_;
+
+        // Защищает создание игровых сессий и их перечисление
+        std::mutex sessions_mutex_;
         std::deque<GameSession> game_sessions_;
         MapIdToIndex map_id_to_index_;
 
@@ -1,53 +1,73 @@
 #pragma once
 
+#include <boost/asio/post.hpp>
 #include <boost/json.hpp>
 
 #include "model.h"
 #include "static_request_parser.h"
 #include "api_request_parser.h"
+#include "api_strands.h"
 
 namespace http_handler {
     namespace json = boost::json;
 
     class RequestHandler : public std::enable_shared_from_this<RequestHandler>  {
-        using Strand = net::strand<net::io_context::executor_type>;
     public:
         explicit RequestHandler(model::Game& game,
-                                std::filesystem::path&& static_path,
-                                Strand strand,
+                                const StaticFileCache& static_files,
+                                const ApiStrands& strands,
+                                GameStateSerializer& state_serializer,
+                                const CompressionOptions& compression,
                                 extra_data::FrontendData&& frontend_data,
                                 bool is_update_time_shift_automatic = false)
-                : strand_{strand},
-                api_parser_{game, is_update_time_shift_automatic, std::move(frontend_data)},
-                static_request_parser_{std::move(static_path)} {
+                : strands_{strands},
+                api_parser_{game, strands, state_serializer, compression, is_update_time_shift_automatic, std::move(frontend_data)},
+                static_request_parser_{static_files} {
 
         }
 
         RequestHandler(const RequestHandler&) = delete;
         RequestHandler& operator=(const RequestHandler&) = delete;
 
-        template <typename Body, typename Allocator>
-        Response operator()(http::request<Body, http::basic_fields<Allocator>>&& req) {
+        // Ответ передаётся в send. Запрос к API ставится в очередь strand'а карты, к которой он относится,
+        // и ответ отправляется оттуда уже после возврата из operator(). Вызывающий поток strand не ждёт.
+        // Ответ на тик отправляется после того, как тик выполнят strand'ы всех карт.
+        template <typename Body, typename Allocator, typename Send>
+        void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send) {
             std::string query{ParseURL(std::string_view{req.target().data(), req.target().size()})};
 
             if (query.substr(0, ApiRequestType::api.size()) == ApiRequestType::api) {
-                auto resp = std::make_shared<StringResponse>();
+                // Чтение состояния сессии обслуживается из её снимка прямо в текущем потоке
+                if (api_parser_.IsSessionSnapshotRequest(query)) {
+                    std::visit([&send](auto&& response) {
+                        send(std::move(response));
+                    }, api_parser_.ParseApiRequest(req, std::move(query)));
+                    return;
+                }
 
-                auto h = [self = shared_from_this(), req = std::forward<decltype(req)>(req), &resp, &query] {
-                    assert(self->strand_.running_in_this_thread());
-                    *resp = self->api_parser_.ParseApiRequest(std::forward<decltype(req)>(req), std::move(query));
+                // Тик и запросы, не относящиеся к конкретной карте, выполняются на общем strand
+                auto target = api_parser_.GetRequestTarget(req, query);
+                const ApiStrands::Strand& strand = target.map_id ? strands_.GetMapStrand(*target.map_id)
+                                                                 : strands_.GetGlobalStrand();
+
+                auto h = [self = shared_from_this(), req = std::forward<decltype(req)>(req), query = std::move(query),
+                          target = std::move(target), send = std::forward<Send>(send), &strand]() mutable {
+                    assert(strand.running_in_this_thread());
+                    self->api_parser_.HandleApiRequest(req, std::move(query), std::move(target), std::move(send));
                 };
 
-                net::dispatch(strand_, h);
+                net::post(strand, std::move(h));
 
-                return *resp;
+                return;
             }
 
-            return static_request_parser_.ParseFileRequest(std::forward<decltype(req)>(req), query);
+            std::visit([&send](auto&& response) {
+                send(std::move(response));
+            }, static_request_parser_.ParseFileRequest(std::forward<decltype(req)>(req), query));
         }
 
     private:
-        Strand strand_;
+        const ApiStrands& strands_;
         ApiRequestParser api_parser_;
         const StaticRequestParser static_request_parser_;
 
@@ -1,6 +1,9 @@
 #include "response_maker.h"
 
+#include <algorithm>
+
 namespace http_handler {
+    using namespace std::literals;
 
     StringResponse MakeMethodNotAllowedResponse(http::status status,
                                                 unsigned http_version,
@@ -34,6 +37,32 @@ namespace http_handler {
         return response;
     }
 
+    SharedResponse MakeSharedResponse(http::status status,
+                                      unsigned http_version,
+                                      bool keep_alive,
+                                      std::string_view content_type,
+                                      SharedBody::value_type body) {
+        constexpr static std::string_view no_cache{"no-cache"};
+        SharedResponse response(status, http_version);
+        response.set(http::field::content_type, content_type);
+        response.content_length(SharedBody::size(body));
+        response.body() = std::move(body);
+        response.keep_alive(keep_alive);
+        response.set(http::field::cache_control, no_cache);
+        return response;
+    }
+
+    StringResponse MakeNotModifiedResponse(unsigned http_version,
+                                           bool keep_alive,
+                                           std::string_view etag) {
+        constexpr static std::string_view no_cache{"no-cache"};
+        StringResponse response(http::status::not_modified, http_version);
+        response.keep_alive(keep_alive);
+        response.set(http::field::cache_control, no_cache);
+        response.set(http::field::etag, etag);
+        return response;
+    }
+
     FileResponse MakeFileResponse(http::status status,
                                   unsigned http_version,
                                   bool keep_alive,
@@ -57,4 +86,37 @@ namespace http_handler {
         return response;
     }
 
-}
+    bool IsETagMatched(std::string_view if_none_match, std::string_view etag) {
+        while (!if_none_match.empty()) {
+            auto tag = if_none_match.substr(0, if_none_match.find(','));
+            if_none_match.remove_prefix(std::min(tag.size() + 1, if_none_match.size()));
+
+            // If-None-Match сравнивает теги без учёта признака слабого тега W/
+            auto begin = tag.find_first_not_of(' ');
+            if (begin == std::string_view::npos) {
+                continue;
+            }
+            tag = tag.substr(begin, tag.find_last_not_of(' ') - begin + 1);
+            if (tag.substr(0, 2) == "W/"sv) {
+                tag.remove_prefix(2);
+            }
+
+            if (tag == "*"sv || tag == etag) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void WriteResponseAndClose(net::ip::tcp::socket&& socket, StringResponse&& response) {
+        auto stream = std::make_shared<beast::tcp_stream>(std::move(socket));
+        auto safe_response = std::make_shared<StringResponse>(std::move(response));
+        safe_response->keep_alive(false);
+
+        http::async_write(*stream, *safe_response, [stream, safe_response](beast::error_code, std::size_t) {
+            beast::error_code ec;
+            stream->socket().shutdown(net::ip::tcp::socket::shutdown_send, ec);
+        });
+    }
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "http_server.h"
+#include "shared_body.h"
 
 #include <filesystem>
 
@@ -13,6 +14,8 @@ namespace http_handler {
     using StringResponse = http::response<http::string_body>;
     // Ответ, тело которого представлено в виде файла
     using FileResponse = http::response<http::file_body>;
+    // Ответ, тело которого - заранее подготовленная строка, разделяемая между ответами
+    using SharedResponse = http::response<SharedBody>;
 
     StringResponse MakeMethodNotAllowedResponse(http::status status,
                                         unsigned http_version,
@@ -27,10 +30,27 @@ namespace http_handler {
                                       std::string_view content_type,
                                       std::string_view body);
 
+    SharedResponse MakeSharedResponse(http::status status,
+                                      unsigned http_version,
+                                      bool keep_alive,
+                                      std::string_view content_type,
+                                      SharedBody::value_type body);
+
+    // Ответ 304 Not Modified на условный запрос: тела нет, клиент использует сохранённую копию
+    StringResponse MakeNotModifiedResponse(unsigned http_version,
+                                           bool keep_alive,
+                                           std::string_view etag);
+
+    // Совпадает ли etag с одним из тегов заголовка If-None-Match
+    bool IsETagMatched(std::string_view if_none_match, std::string_view etag);
+
     FileResponse MakeFileResponse(http::status status,
                                   unsigned http_version,
                                   bool keep_alive,
                                   std::string_view content_type,
                                   const std::filesystem::path& path);
 
+    // Отправляет ответ в сокет, который забрал у HTTP-сессии потоковый обработчик, и закрывает соединение
+    void WriteResponseAndClose(net::ip::tcp::socket&& socket, StringResponse&& response);
+
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <boost/json.hpp>
 #include <boost/beast/http.hpp>
 
+#include "shared_body.h"
+
 #include <variant>
 #include <string_view>
 
@@ -17,19 +19,12 @@ namespace server_logging {
     using StringResponse = http::response<http::string_body>;
     // Ответ, тело которого представлено в виде файла
     using FileResponse = http::response<http::file_body>;
-    using Response = std::variant<StringResponse, FileResponse>;
+    // Ответ, тело которого - строка, разделяемая между ответами
+    using SharedResponse = http::response<http_handler::SharedBody>;
+    using Response = std::variant<StringResponse, FileResponse, SharedResponse>;
     using Logger = std::function<void(json::value, std::string_view)>;
 
     class LoggingRequestHandler {
-        template <typename Body, typename Allocator>
-        static void LogRequest(const Logger& log, const http::request<Body, http::basic_fields<Allocator>>& req, std::string&& user_ip_endpoint) {
-            json::value request_received_log{{"ip", user_ip_endpoint.data()},
-                                             {"URI", req.target()},
-                                             {"method", req.method_string()}};
-
-            log(std::move(request_received_log), "request received"sv);
-        }
-
         template<class Resp>
         static void LogResponse(const Logger& log, const Resp& response, int total_time_parse_res) {
             json::value response_sent_log{{"response_time", total_time_parse_res},
@@ -40,6 +35,17 @@ namespace server_logging {
         }
 
     public:
+        // Запросы, после которых соединение становится потоковым, минуют обработчик:
+        // их записывает в журнал тот, кто принимает соединение
+        template <typename Body, typename Allocator>
+        static void LogRequest(const Logger& log, const http::request<Body, http::basic_fields<Allocator>>& req, std::string&& user_ip_endpoint) {
+            json::value request_received_log{{"ip", user_ip_endpoint.data()},
+                                             {"URI", req.target()},
+                                             {"method", req.method_string()}};
+
+            log(std::move(request_received_log), "request received"sv);
+        }
+
         explicit LoggingRequestHandler(std::shared_ptr<http_handler::RequestHandler> decorated)
                 : decorated_(decorated) {
 
@@ -54,17 +60,17 @@ namespace server_logging {
 
             std::chrono::system_clock::time_point start_ts_ = std::chrono::system_clock::now();
 
-            Response response = (*decorated_)(std::forward<decltype(req)>(req));
-
-            std::chrono::system_clock::time_point end_ts = std::chrono::system_clock::now();
+            // Ответ может быть сформирован асинхронно, поэтому время обработки считаем в момент отправки.
+            // log копируем: он может оказаться временным объектом, живущим только до возврата из operator()
+            auto send_response_and_log = [start_ts_, send = std::forward<Send>(send), log] (auto&& response) {
+                std::chrono::system_clock::time_point end_ts = std::chrono::system_clock::now();
 
-            auto total_time = (end_ts - start_ts_).count();
-            auto send_response_and_log = [total_time, send, &log] (auto&& response) {
+                auto total_time = (end_ts - start_ts_).count();
                 LogResponse(log, response, total_time);
                 send(response);
             };
 
-            std::visit(send_response_and_log, std::move(response));
+            (*decorated_)(std::forward<decltype(req)>(req), std::move(send_response_and_log));
         }
 
     private:
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace http_handler {
+    namespace beast = boost::beast;
+    namespace http = beast::http;
+    namespace net = boost::asio;
+
+    // Тело ответа в виде неизменяемой строки с разделяемым владением.
+    // Заранее подготовленное тело отправляется многим клиентам без копирования: каждый ответ
+    // лишь продлевает время жизни строки до окончания записи. Используется только для отправки ответов.
+    struct SharedBody {
+        using value_type = std::shared_ptr<const std::string>;
+
+        static std::uint64_t size(const value_type& body) {
+            return body ? body->size() : 0;
+        }
+
+        class writer {
+        public:
+            using const_buffers_type = net::const_buffer;
+
+            template <bool isRequest, class Fields>
+            writer(const http::header<isRequest, Fields>&, const value_type& body)
+                    : body_(body) {
+            }
+
+            void init(beast::error_code& ec) {
+                ec = {};
+            }
+
+            boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+                ec = {};
+                if (!body_ || body_->empty()) {
+                    return boost::none;
+                }
+                // Вся строка уже в памяти, поэтому отдаём её одним буфером
+                return std::make_pair(net::const_buffer{body_->data(), body_->size()}, false);
+            }
+
+        private:
+            const value_type& body_;
+        };
+    };
+}  // namespace http_handler
@@ -0,0 +1,201 @@
+#include "spectator_hub.h"
+
+#include "api_request_parser.h"
+#include "http_handler_string_constants.h"
+
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/write.hpp>
+
+#include <charconv>
+
+namespace http_handler {
+    using namespace std::literals;
+
+    void SpectatorSession::Run(unsigned http_version) {
+        header_.version(http_version);
+        header_.result(http::status::ok);
+        header_.set(http::field::content_type, ContentType::TEXT_EVENT_STREAM);
+        header_.set(http::field::cache_control, "no-cache"sv);
+        // Длина потока заранее неизвестна: события передаются, пока соединение не закроется
+        header_.keep_alive(false);
+
+        net::dispatch(stream_.get_executor(), [self = shared_from_this()] {
+            http::async_write_header(self->stream_, self->header_serializer_, [self](beast::error_code ec, std::size_t) {
+                self->OnWriteHeader(ec);
+            });
+        });
+    }
+
+    void SpectatorSession::Push(std::shared_ptr<const std::string> event) {
+        net::post(stream_.get_executor(), [self = shared_from_this(), event = std::move(event)]() mutable {
+            if (self->closed_) {
+                return;
+            }
+            self->queue_.push_back(std::move(event));
+            // Зритель не успевает за тиками: отключаем его, чтобы очередь не росла без ограничений
+            if (self->queue_.size() > kMaxQueuedEvents) {
+                return self->Close();
+            }
+            self->Write();
+        });
+    }
+
+    void SpectatorSession::OnWriteHeader(beast::error_code ec) {
+        if (ec) {
+            return Close();
+        }
+        header_written_ = true;
+
+        WaitForClose();
+        Write();
+    }
+
+    void SpectatorSession::WaitForClose() {
+        stream_.async_read_some(net::buffer(read_buffer_), [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) {
+                return self->Close();
+            }
+            self->WaitForClose();
+        });
+    }
+
+    void SpectatorSession::Write() {
+        if (closed_ || !header_written_ || !writing_events_.empty() || queue_.empty()) {
+            return;
+        }
+
+        // Всё, что накопилось за время предыдущей записи, отправляем одной операцией
+        std::vector<net::const_buffer> buffers;
+        buffers.reserve(queue_.size());
+        for (auto& event : queue_) {
+            buffers.emplace_back(event->data(), event->size());
+            writing_events_.push_back(std::move(event));
+        }
+        queue_.clear();
+
+        net::async_write(stream_, buffers, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            self->OnWrite(ec);
+        });
+    }
+
+    void SpectatorSession::OnWrite(beast::error_code ec) {
+        writing_events_.clear();
+        if (ec) {
+            return Close();
+        }
+        Write();
+    }
+
+    void SpectatorSession::Close() {
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+        queue_.clear();
+
+        // Незавершённые операции с сокетом прерываются, и соединение освобождается
+        beast::error_code ec;
+        stream_.socket().shutdown(tcp::socket::shutdown_both, ec);
+        stream_.socket().close(ec);
+    }
+
+    SpectatorHub::SpectatorHub(model::Game& game, GameStateSerializer& state_serializer)
+            : game_(game)
+            , state_serializer_(state_serializer) {
+        for (const auto& map : game.GetMaps()) {
+            maps_.try_emplace(map.GetId());
+        }
+    }
+
+    void SpectatorHub::Accept(tcp::socket&& socket, http::request<http::string_body>&& req) {
+        auto [path, params] = ApiRequestParser::SplitQueryParams(req.target());
+        if (path != ApiRequestType::spectate) {
+            return WriteResponseAndClose(std::move(socket), MakeStringResponse(http::status::bad_request,
+                                                                              req.version(),
+                                                                              false,
+                                                                              ContentType::APPLICATION_JSON,
+                                                                              ErrorMessages::badRequest));
+        }
+
+        auto map_id = ApiRequestParser::FindQueryParam(params, ApiQueryParam::map);
+        auto it = map_id ? maps_.find(model::Map::Id{std::string{*map_id}}) : maps_.end();
+        if (it == maps_.end()) {
+            return WriteResponseAndClose(std::move(socket), MakeStringResponse(http::status::not_found,
+                                                                              req.version(),
+                                                                              false,
+                                                                              ContentType::APPLICATION_JSON,
+                                                                              ErrorMessages::mapNotFound));
+        }
+
+        // Некорректный Last-Event-ID не мешает подписке: зритель получит всё состояние
+        uint64_t since = 0;
+        std::string_view last_event_id = req["Last-Event-ID"sv];
+        std::from_chars(last_event_id.data(), last_event_id.data() + last_event_id.size(), since);
+
+        auto session = std::make_shared<SpectatorSession>(std::move(socket));
+        {
+            // Рассылка выполняется под той же блокировкой, поэтому первое событие зрителя
+            // не может оказаться новее следующего за ним события рассылки
+            MapSpectators& spectators = it->second;
+            std::lock_guard lock{spectators.mutex};
+            std::erase_if(spectators.sessions, [](const std::weak_ptr<SpectatorSession>& weak_session) {
+                return weak_session.expired();
+            });
+
+            if (model::GameSession* game_session = game_.FindGameSession(it->first)) {
+                auto state = state_serializer_.GetGameStateDelta(game_session, since);
+                // Других зрителей нет, поэтому следующая рассылка может начаться с версии этого зрителя
+                if (spectators.sessions.empty()) {
+                    spectators.version = state->version;
+                }
+                session->Push(MakeEvent(*state));
+            }
+            spectators.sessions.push_back(session);
+        }
+
+        session->Run(req.version());
+    }
+
+    void SpectatorHub::Broadcast(const model::GameSession* game_session) {
+        auto it = maps_.find(game_session->GetMap()->GetId());
+        if (it == maps_.end()) {
+            return;
+        }
+
+        MapSpectators& spectators = it->second;
+        std::lock_guard lock{spectators.mutex};
+        std::erase_if(spectators.sessions, [](const std::weak_ptr<SpectatorSession>& weak_session) {
+            return weak_session.expired();
+        });
+        if (spectators.sessions.empty()) {
+            return;
+        }
+
+        auto state = state_serializer_.GetGameStateDelta(game_session, spectators.version);
+        if (state->version == spectators.version) {
+            return;
+        }
+        spectators.version = state->version;
+
+        // Событие одно на всех зрителей, Push лишь ставит указатель на него в очередь соединения
+        auto event = MakeEvent(*state);
+        for (const auto& weak_session : spectators.sessions) {
+            if (auto session = weak_session.lock()) {
+                session->Push(event);
+            }
+        }
+    }
+
+    std::shared_ptr<const std::string> SpectatorHub::MakeEvent(const GameStateSerializer::SerializedState& state) {
+        // JSON сериализатора не содержит переводов строк, поэтому помещается в одно поле data
+        auto event = std::make_shared<std::string>();
+        event->reserve(state.text.size() + 32);
+        *event += "id: "sv;
+        *event += std::to_string(state.version);
+        *event += "\ndata: "sv;
+        *event += state.text;
+        *event += "\n\n"sv;
+        return event;
+    }
+}  // namespace http_handler
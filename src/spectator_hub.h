@@ -0,0 +1,99 @@
+#pragma once
+
+#include "response_maker.h"
+#include "model.h"
+#include "game_state_serializer.h"
+
+#include <array>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace http_handler {
+    namespace net = boost::asio;
+    namespace beast = boost::beast;
+    namespace http = beast::http;
+    using tcp = net::ip::tcp;
+
+    // Соединение зрителя, получающего поток text/event-stream. Событие - разделяемая всеми зрителями карты
+    // неизменяемая строка, в очередь соединения кладётся только указатель на неё.
+    // Все операции с потоком выполняются в strand'е соединения.
+    class SpectatorSession : public std::enable_shared_from_this<SpectatorSession> {
+    public:
+        // Больше событий в очереди зритель не успевает принять, и соединение закрывается
+        constexpr static std::size_t kMaxQueuedEvents = 256;
+
+        explicit SpectatorSession(tcp::socket&& socket)
+                : stream_(std::move(socket)) {
+        }
+
+        SpectatorSession(const SpectatorSession&) = delete;
+        SpectatorSession& operator=(const SpectatorSession&) = delete;
+
+        // Отправляет заголовок ответа и начинает передачу событий
+        void Run(unsigned http_version);
+
+        // Ставит событие в очередь отправки. Может вызываться из любого потока
+        void Push(std::shared_ptr<const std::string> event);
+
+    private:
+        beast::tcp_stream stream_;
+        http::response<http::empty_body> header_;
+        http::response_serializer<http::empty_body> header_serializer_{header_};
+        // Клиент ничего не передаёт, чтение лишь сообщает о закрытии соединения
+        std::array<char, 64> read_buffer_;
+
+        std::deque<std::shared_ptr<const std::string>> queue_;
+        // События, которые передаются сейчас. Держат строки до окончания записи
+        std::vector<std::shared_ptr<const std::string>> writing_events_;
+        bool header_written_ = false;
+        bool closed_ = false;
+
+        void OnWriteHeader(beast::error_code ec);
+
+        void WaitForClose();
+
+        void Write();
+
+        void OnWrite(beast::error_code ec);
+
+        void Close();
+    };
+
+    // Принимает зрителей карт и после каждого тика рассылает им изменения игровой сессии.
+    // Событие кодируется один раз на тик и раздаётся всем зрителям карты.
+    class SpectatorHub {
+    public:
+        SpectatorHub(model::Game& game, GameStateSerializer& state_serializer);
+
+        SpectatorHub(const SpectatorHub&) = delete;
+        SpectatorHub& operator=(const SpectatorHub&) = delete;
+
+        // Подписывает зрителя на карту из параметра map. Первое событие содержит всё состояние игры
+        // или изменения с версии из заголовка Last-Event-ID при переподключении.
+        void Accept(tcp::socket&& socket, http::request<http::string_body>&& req);
+
+        // Рассылает зрителям карты изменения сессии с предыдущего события. Вызывается после тика сессии
+        void Broadcast(const model::GameSession* game_session);
+
+    private:
+        struct MapSpectators {
+            std::mutex mutex;
+            // Версия состояния в последнем разосланном событии
+            uint64_t version = 0;
+            // Закрытые соединения удаляются из списка при следующей рассылке
+            std::vector<std::weak_ptr<SpectatorSession>> sessions;
+        };
+
+        model::Game& game_;
+        GameStateSerializer& state_serializer_;
+        // Заполняется для всех карт при создании, поэтому сам словарь читается без блокировки
+        std::unordered_map<model::Map::Id, MapSpectators, model::Game::MapIdHasher> maps_;
+
+        // Событие вида "id: <версия>\ndata: <JSON>\n\n"
+        static std::shared_ptr<const std::string> MakeEvent(const GameStateSerializer::SerializedState& state);
+    };
+}  // namespace http_handler
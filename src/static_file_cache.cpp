@@ -0,0 +1,231 @@
+#include "static_file_cache.h"
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+
+#ifdef __linux__
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <sys/inotify.h>
+#endif
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <locale>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace http_handler {
+    using namespace std::literals;
+    namespace fs = std::filesystem;
+
+#ifdef __linux__
+    // Следит за каталогом статики и его подкаталогами и перечитывает каталог после изменений.
+    // Чтение событий и перезагрузка выполняются в одном strand'е
+    class StaticFileCache::Watcher {
+    public:
+        Watcher(net::io_context& ioc, StaticFileCache& cache)
+                : cache_(cache)
+                , strand_(net::make_strand(ioc))
+                , descriptor_(strand_)
+                , timer_(strand_) {
+            int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "Failed to watch static files");
+            }
+            descriptor_.assign(fd);
+
+            AddWatches();
+            Read();
+        }
+
+    private:
+        // Запись файлов при выкладке порождает серию событий: перезагрузка выполняется,
+        // когда за это время не пришло новых
+        constexpr static auto kReloadDelay = 200ms;
+        constexpr static uint32_t kWatchMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_ATTRIB
+                                               | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+        StaticFileCache& cache_;
+        net::strand<net::io_context::executor_type> strand_;
+        net::posix::stream_descriptor descriptor_;
+        net::steady_timer timer_;
+        std::array<char, 4096> buffer_;
+
+        // Каталоги, созданные после запуска, добавляются при каждой перезагрузке.
+        // Повторное добавление уже наблюдаемого каталога ничего не меняет
+        void AddWatches() {
+            const int fd = descriptor_.native_handle();
+            inotify_add_watch(fd, cache_.root_.c_str(), kWatchMask);
+
+            std::error_code ec;
+            for (auto it = fs::recursive_directory_iterator(cache_.root_, fs::directory_options::skip_permission_denied, ec);
+                 !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+                if (std::error_code dir_ec; it->is_directory(dir_ec)) {
+                    inotify_add_watch(fd, it->path().c_str(), kWatchMask);
+                }
+            }
+        }
+
+        void Read() {
+            descriptor_.async_read_some(net::buffer(buffer_), [this](boost::system::error_code ec, std::size_t) {
+                if (ec) {
+                    return;
+                }
+                // События не разбираются: любое изменение приводит к перечитыванию каталога
+                timer_.expires_after(kReloadDelay);
+                timer_.async_wait([this](boost::system::error_code ec) {
+                    if (ec) {
+                        return;
+                    }
+                    try {
+                        cache_.Reload();
+                    } catch (const std::exception&) {
+                        // Каталог временно недоступен: отдаются прежние файлы до следующего изменения
+                    }
+                    AddWatches();
+                });
+                Read();
+            });
+        }
+    };
+#else
+    class StaticFileCache::Watcher {
+    public:
+        Watcher(net::io_context&, StaticFileCache&) {
+            throw std::runtime_error("Watching static files is supported only on Linux"s);
+        }
+    };
+#endif
+
+    StaticFileCache::StaticFileCache(fs::path root, const CompressionOptions& compression)
+            : root_(fs::weakly_canonical(root))
+            , compression_(compression) {
+        Reload();
+    }
+
+    StaticFileCache::~StaticFileCache() = default;
+
+    std::shared_ptr<const StaticFileCache::File> StaticFileCache::Find(std::string_view path) const {
+        auto files = files_.load();
+        if (auto it = files->find(std::string{path}); it != files->end()) {
+            return it->second;
+        }
+        return nullptr;
+    }
+
+    void StaticFileCache::Reload() {
+        auto previous = files_.load();
+        auto files = std::make_shared<Files>();
+
+        std::error_code ec;
+        for (auto it = fs::recursive_directory_iterator(root_, fs::directory_options::skip_permission_denied, ec);
+             !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            std::error_code file_ec;
+            // Ссылки на файлы за пределами каталога статики не отдаются
+            if (!it->is_regular_file(file_ec) || !IsSubPath(it->path(), root_)) {
+                continue;
+            }
+
+            const auto size = it->file_size(file_ec);
+            const auto last_write_time = it->last_write_time(file_ec);
+            if (file_ec) {
+                continue;
+            }
+
+            std::string key = it->path().lexically_relative(root_).generic_string();
+            if (previous) {
+                if (auto found = previous->find(key); found != previous->end()
+                    && found->second->size == size && found->second->last_write_time == last_write_time) {
+                    files->emplace(std::move(key), found->second);
+                    continue;
+                }
+            }
+
+            if (auto file = LoadFile(it->path(), size, last_write_time)) {
+                files->emplace(std::move(key), std::move(file));
+            }
+        }
+
+        if (ec) {
+            throw std::runtime_error("Failed to read static files from "s + root_.string() + ": "s + ec.message());
+        }
+
+        files_.store(std::move(files));
+    }
+
+    void StaticFileCache::Watch(net::io_context& ioc) {
+        watcher_ = std::make_unique<Watcher>(ioc, *this);
+    }
+
+    std::shared_ptr<const StaticFileCache::File> StaticFileCache::LoadFile(const fs::path& path, std::uintmax_t size,
+                                                                           fs::file_time_type last_write_time) const {
+        std::ifstream input(path, std::ios::binary);
+        std::string content{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+        if (!input && !input.eof()) {
+            return nullptr;
+        }
+
+        auto file = std::make_shared<File>();
+        auto content_type = file_format_to_content_type_.find(path.extension().string());
+        file->content_type = content_type != file_format_to_content_type_.end() ?
+                             content_type->second : ContentType::APPLICATION_OCTET_STREAM;
+
+        std::ostringstream etag;
+        etag << '"' << std::hex << content.size() << '-' << std::hash<std::string_view>{}(content) << '"';
+        file->etag = etag.str();
+
+        const auto sys_time = std::chrono::file_clock::to_sys(last_write_time);
+        file->last_modified_time = std::chrono::system_clock::to_time_t(
+                std::chrono::time_point_cast<std::chrono::system_clock::duration>(sys_time));
+        file->last_modified = FormatHttpDate(file->last_modified_time);
+        file->size = size;
+        file->last_write_time = last_write_time;
+
+        if (IsCompressible(file->content_type)) {
+            file->gzip_body = MakeGzipBody(content, compression_);
+        }
+        file->body = std::make_shared<const std::string>(std::move(content));
+
+        return file;
+    }
+
+    bool StaticFileCache::IsSubPath(fs::path path, fs::path base) {
+        // Приводим оба пути к каноничному виду (без . и ..)
+        path = fs::weakly_canonical(path);
+        base = fs::weakly_canonical(base);
+
+        // Проверяем, что все компоненты base содержатся внутри path
+        for (auto b = base.begin(), p = path.begin(); b != base.end(); ++b, ++p) {
+            if (p == path.end() || *p != *b) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string FormatHttpDate(std::time_t time) {
+        std::tm tm{};
+        gmtime_r(&time, &tm);
+
+        std::ostringstream date;
+        date.imbue(std::locale::classic());
+        date << std::put_time(&tm, "%a, %d %b %Y %H:%M:%S GMT");
+        return date.str();
+    }
+
+    std::optional<std::time_t> ParseHttpDate(std::string_view date) {
+        std::tm tm{};
+        std::istringstream input{std::string{date}};
+        input.imbue(std::locale::classic());
+        input >> std::get_time(&tm, "%a, %d %b %Y %H:%M:%S");
+        if (input.fail()) {
+            return std::nullopt;
+        }
+        return timegm(&tm);
+    }
+}  // namespace http_handler
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "http_handler_string_constants.h"
+#include "response_maker.h"
+#include "compression.h"
+
+#include <boost/asio/io_context.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace http_handler {
+    namespace net = boost::asio;
+
+    // Содержимое каталога статических файлов, загруженное в память при запуске.
+    // Запросы к статике обслуживаются из памяти без обращений к файловой системе.
+    // Набор файлов заменяется целиком при перезагрузке, поэтому поиск выполняется без блокировок.
+    class StaticFileCache {
+    public:
+        struct File {
+            SharedBody::value_type body;
+            // Тело, сжатое в gzip; nullptr, если сжатие отключено или бесполезно
+            SharedBody::value_type gzip_body;
+            std::string_view content_type;
+            // Строится по содержимому, поэтому не меняется, если файл перезаписан теми же данными
+            std::string etag;
+            // Время изменения файла в формате HTTP-даты и в секундах для сравнения с If-Modified-Since
+            std::string last_modified;
+            std::time_t last_modified_time;
+
+            // По ним при перезагрузке определяется, что файл не изменился и его не нужно сжимать заново
+            std::uintmax_t size;
+            std::filesystem::file_time_type last_write_time;
+        };
+
+        StaticFileCache(std::filesystem::path root, const CompressionOptions& compression);
+        ~StaticFileCache();
+
+        StaticFileCache(const StaticFileCache&) = delete;
+        StaticFileCache& operator=(const StaticFileCache&) = delete;
+
+        // Файл по пути относительно корня вида "js/app.js"; nullptr, если такого файла нет
+        std::shared_ptr<const File> Find(std::string_view path) const;
+
+        // Перечитывает каталог. Неизменившиеся файлы берутся из текущего набора
+        void Reload();
+
+        // Перечитывает каталог после изменений в нём, о которых сообщает inotify (только Linux).
+        // Изменения, пришедшие подряд, собираются в одну перезагрузку
+        void Watch(net::io_context& ioc);
+
+    private:
+        using Files = std::unordered_map<std::string, std::shared_ptr<const File>>;
+
+        const std::filesystem::path root_;
+        const CompressionOptions compression_;
+        std::atomic<std::shared_ptr<const Files>> files_;
+
+        class Watcher;
+        std::unique_ptr<Watcher> watcher_;
+
+        //Структура, которая преобразует расширение файла в содержимое заголовка ContentType
+        using FFToCT = std::unordered_map<std::string_view, std::string_view>;
+        const FFToCT file_format_to_content_type_{{FileFormats::html, ContentType::TEXT_HTML},
+                                                  {FileFormats::js, ContentType::TEXT_JAVASCRIPT},
+                                                  {FileFormats::json, ContentType::APPLICATION_JSON},
+                                                  {FileFormats::svg, ContentType::IMAGE_SVG},
+                                                  {FileFormats::png, ContentType::IMAGE_PNG}};
+
+        std::shared_ptr<const File> LoadFile(const std::filesystem::path& path, std::uintmax_t size,
+                                             std::filesystem::file_time_type last_write_time) const;
+
+        // Возвращает true, если каталог p содержится внутри base_path.
+        static bool IsSubPath(std::filesystem::path path, std::filesystem::path base);
+    };
+
+    // HTTP-дата вида "Sun, 06 Nov 1994 08:49:37 GMT"
+    std::string FormatHttpDate(std::time_t time);
+
+    // Время из HTTP-даты; nullopt, если строка не является датой
+    std::optional<std::time_t> ParseHttpDate(std::string_view date);
+}  // namespace http_handler
@@ -1,29 +1,37 @@
-#include "static_request_parser.h"
-
-namespace http_handler {
-
-    std::filesystem::path StaticRequestParser::GetFilePath(std::string_view query) const {
-        auto get_another = [&query] (const std::filesystem::path& static_path) {
-            query.remove_prefix(1);
-            return std::filesystem::weakly_canonical(static_path / query);
-        };
-        //Файл с именем index может быть получен по двум именам из адресной строки запроса
-        return (query == "/"sv || query == GetFileRequestType::index) ?
-               std::filesystem::weakly_canonical(static_path_ / GetFileRequestType::index) : get_another(static_path_);
-    }
-
-    bool StaticRequestParser::IsSubPath(fs::path path, fs::path base) {
-        // Приводим оба пути к каноничному виду (без . и ..)
-        path = fs::weakly_canonical(path);
-        base = fs::weakly_canonical(base);
-
-        // Проверяем, что все компоненты base содержатся внутри path
-        for (auto b = base.begin(), p = path.begin(); b != base.end(); ++b, ++p) {
-            if (p == path.end() || *p != *b) {
-                return false;
-            }
-        }
-        return true;
-    }
-
+#include "static_request_parser.h"
+
+#include <filesystem>
+
+namespace http_handler {
+
+    std::optional<std::string> StaticRequestParser::GetFilePath(std::string_view query) {
+        // Параметры после '?' не относятся к файлу: ими обычно сбрасывают кэш браузера
+        query = query.substr(0, query.find('?'));
+
+        //Файл с именем index может быть получен по двум именам из адресной строки запроса
+        std::filesystem::path path = std::filesystem::path{query}.relative_path().lexically_normal();
+        if (path.empty() || path == "."sv) {
+            return std::string{GetFileRequestType::index};
+        }
+
+        // Путь сводится к каталогу статики без обращения к файловой системе: выход из него через ".." запрещён
+        if (*path.begin() == ".."sv) {
+            return std::nullopt;
+        }
+        return path.generic_string();
+    }
+
+    bool StaticRequestParser::IsNotModified(const StaticFileCache::File& file,
+                                            std::string_view if_none_match,
+                                            std::string_view if_modified_since) {
+        if (!if_none_match.empty()) {
+            return IsETagMatched(if_none_match, file.etag);
+        }
+        if (if_modified_since.empty()) {
+            return false;
+        }
+        auto since = ParseHttpDate(if_modified_since);
+        return since && file.last_modified_time <= *since;
+    }
+
 }
\ No newline at end of file
@@ -1,83 +1,98 @@
-#pragma once
-
-#include "http_handler_string_constants.h"
-#include "response_maker.h"
-
-#include <unordered_map>
-#include <string_view>
-#include <filesystem>
-#include <variant>
-
-#include <iostream>
-
-namespace http_handler {
-    using Response = std::variant<StringResponse, FileResponse>;
-
-    class StaticRequestParser {
-    public:
-        StaticRequestParser() = delete;
-        explicit StaticRequestParser(std::filesystem::path&& static_path)
-                : static_path_(std::move(static_path)) {
-
-        }
-
-        StaticRequestParser(const StaticRequestParser&) = delete;
-        StaticRequestParser& operator=(const StaticRequestParser&) = delete;
-
-        template <typename Body, typename Allocator>
-        Response ParseFileRequest(http::request<Body, http::basic_fields<Allocator>>&& req,
-                                  std::string_view query) const {
-            if (req.method() != http::verb::get && req.method() != http::verb::head) {
-                return MakeStringResponse(http::status::method_not_allowed,
-                                          req.version(),
-                                          req.keep_alive(),
-                                          ContentType::TEXT_HTML,
-                                          ErrorMessages::invalidMethod);
-            }
-
-            std::filesystem::path abs_path = GetFilePath(query);
-
-            if (!IsSubPath(abs_path, static_path_)) {
-                return MakeStringResponse(http::status::bad_request,
-                                          req.version(),
-                                          req.keep_alive(),
-                                          ContentType::TEXT_PLAIN,
-                                          ErrorMessages::badRequest);
-            }
-
-            std::string ext = abs_path.extension().string();
-
-            if (!fs::exists(abs_path)) {
-                return MakeStringResponse(http::status::not_found,
-                                          req.version(),
-                                          req.keep_alive(),
-                                          ContentType::TEXT_PLAIN,
-                                          ErrorMessages::fileNotFound);
-            }
-
-            std::string_view content_type = ((file_format_to_content_type_.count(ext)) ?
-                                             file_format_to_content_type_.at(ext) : ContentType::APPLICATION_OCTET_STREAM);
-
-            return MakeFileResponse(http::status::ok,
-                                    req.version(),
-                                    req.keep_alive(),
-                                    content_type,
-                                    abs_path);
-        }
-
-    private:
-        const std::filesystem::path static_path_;
-
-        //Структура, которая преобразует расширение файла в содержимое заголовка ContentType
-        using FFToCT = std::unordered_map<std::string_view, std::string_view>;
-        const FFToCT file_format_to_content_type_{{FileFormats::html, ContentType::TEXT_HTML},
-                                                  {FileFormats::js, ContentType::TEXT_JAVASCRIPT},
-                                                  {FileFormats::json, ContentType::APPLICATION_JSON},
-                                                  {FileFormats::svg, ContentType::IMAGE_SVG},
-                                                  {FileFormats::png, ContentType::IMAGE_PNG}};
-
-        std::filesystem::path GetFilePath(std::string_view query) const;
-        // Возвращает true, если каталог p содержится внутри base_path.
-        static bool IsSubPath(fs::path path, fs::path base);
-    };
-}
+#pragma once
+
+#include "http_handler_string_constants.h"
+#include "response_maker.h"
+#include "static_file_cache.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+
+namespace http_handler {
+    // Файлы отдаются из кэша в памяти, поэтому ответ разделяет тело с кэшем
+    using Response = std::variant<StringResponse, SharedResponse>;
+
+    class StaticRequestParser {
+    public:
+        StaticRequestParser() = delete;
+        explicit StaticRequestParser(const StaticFileCache& files)
+                : files_(files) {
+
+        }
+
+        StaticRequestParser(const StaticRequestParser&) = delete;
+        StaticRequestParser& operator=(const StaticRequestParser&) = delete;
+
+        template <typename Body, typename Allocator>
+        Response ParseFileRequest(http::request<Body, http::basic_fields<Allocator>>&& req,
+                                  std::string_view query) const {
+            if (req.method() != http::verb::get && req.method() != http::verb::head) {
+                return MakeStringResponse(http::status::method_not_allowed,
+                                          req.version(),
+                                          req.keep_alive(),
+                                          ContentType::TEXT_HTML,
+                                          ErrorMessages::invalidMethod);
+            }
+
+            auto file_path = GetFilePath(query);
+
+            if (!file_path) {
+                return MakeStringResponse(http::status::bad_request,
+                                          req.version(),
+                                          req.keep_alive(),
+                                          ContentType::TEXT_PLAIN,
+                                          ErrorMessages::badRequest);
+            }
+
+            auto file = files_.Find(*file_path);
+
+            if (!file) {
+                return MakeStringResponse(http::status::not_found,
+                                          req.version(),
+                                          req.keep_alive(),
+                                          ContentType::TEXT_PLAIN,
+                                          ErrorMessages::fileNotFound);
+            }
+
+            if (IsNotModified(*file, req[http::field::if_none_match], req[http::field::if_modified_since])) {
+                auto response = MakeNotModifiedResponse(req.version(), req.keep_alive(), file->etag);
+                SetFileHeaders(response, *file);
+                return response;
+            }
+
+            // Сжатое тело готово заранее, поэтому файл отдаётся в gzip без затрат на сжатие
+            const bool gzip = file->gzip_body && IsGzipAccepted(req[http::field::accept_encoding]);
+            auto response = MakeSharedResponse(http::status::ok,
+                                               req.version(),
+                                               req.keep_alive(),
+                                               file->content_type,
+                                               gzip ? file->gzip_body : file->body);
+            response.set(http::field::etag, file->etag);
+            SetFileHeaders(response, *file);
+            if (gzip) {
+                MarkGzipEncoded(response);
+            }
+            return response;
+        }
+
+    private:
+        const StaticFileCache& files_;
+
+        // Путь файла относительно каталога статики; nullopt, если путь выходит за пределы каталога
+        static std::optional<std::string> GetFilePath(std::string_view query);
+
+        // Есть ли у клиента эта версия файла. If-Modified-Since учитывается, только если нет If-None-Match
+        static bool IsNotModified(const StaticFileCache::File& file,
+                                  std::string_view if_none_match,
+                                  std::string_view if_modified_since);
+
+        template <typename Body>
+        static void SetFileHeaders(http::response<Body>& response, const StaticFileCache::File& file) {
+            response.set(http::field::last_modified, file.last_modified);
+            if (file.gzip_body) {
+                AddVary(response, "Accept-Encoding"sv);
+            }
+        }
+    };
+}
@@ -13,7 +13,8 @@ namespace time_shift {
 
     void Ticker::ScheduleTick() {
         assert(strand_.running_in_this_thread());
-        timer_.expires_after(period_);
+        // Отсчитываем период от начала прошлого тика: если тик затянулся, следующий начнётся сразу
+        timer_.expires_at(last_tick_ + period_);
         timer_.async_wait([self = shared_from_this()](sys::error_code ec) {
             self->OnTick(ec);
         });
@@ -28,11 +29,19 @@ namespace time_shift {
             auto delta = duration_cast<milliseconds>(this_tick - last_tick_);
             last_tick_ = this_tick;
             try {
-                handler_(delta);
+                handler_(delta, [self = shared_from_this()] {
+                    self->OnTickComplete();
+                });
             } catch (...) {
+                ScheduleTick();
             }
-            ScheduleTick();
         }
     }
 
+    void Ticker::OnTickComplete() {
+        net::dispatch(strand_, [self = shared_from_this()] {
+            self->ScheduleTick();
+        });
+    }
+
 }
@@ -11,9 +11,13 @@ namespace time_shift {
     class Ticker : public std::enable_shared_from_this<Ticker> {
     public:
         using Strand = net::strand<net::io_context::executor_type>;
-        using Handler = std::function<void(std::chrono::milliseconds delta)>;
+        // Вызывается, когда работа, запущенная обработчиком тика, завершена. Может вызываться из любого потока
+        using Completion = std::function<void()>;
+        using Handler = std::function<void(std::chrono::milliseconds delta, Completion on_complete)>;
 
-        // Функция handler будет вызываться внутри strand с интервалом period
+        // Функция handler будет вызываться внутри strand с интервалом period. Следующий тик начинается
+        // только после вызова on_complete: если тик длится дольше периода, тики не копятся в очереди,
+        // а следующий сдвигает время на всё прошедшее с начала предыдущего
         Ticker(Strand strand, std::chrono::milliseconds period, Handler handler)
                 : strand_{strand}
                 , period_{period}
@@ -27,6 +31,8 @@ namespace time_shift {
 
         void OnTick(sys::error_code ec);
 
+        void OnTickComplete();
+
         using Clock = std::chrono::steady_clock;
 
         Strand strand_;
@@ -0,0 +1,207 @@
+#include "websocket_hub.h"
+
+#include "api_request_parser.h"
+#include "http_handler_string_constants.h"
+
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
+
+namespace http_handler {
+
+    namespace {
+        // Кадры от клиента - короткие действия игрока, длинные сообщения отклоняются
+        constexpr std::size_t kMaxMessageSize = 4096;
+    }  // namespace
+
+    WebSocketSession::WebSocketSession(tcp::socket&& socket, WebSocketHub& hub, model::Player& player,
+                                       const ApiStrands& strands, GameStateSerializer& state_serializer)
+            : ws_(std::move(socket))
+            , hub_(hub)
+            , player_(player)
+            , strands_(strands)
+            , map_strand_(strands.GetMapStrand(player.GetGameSession()->GetMap()->GetId()))
+            , state_serializer_(state_serializer) {
+    }
+
+    void WebSocketSession::Run(http::request<http::string_body>&& req) {
+        auto safe_req = std::make_shared<http::request<http::string_body>>(std::move(req));
+
+        net::dispatch(ws_.get_executor(), [self = shared_from_this(), safe_req] {
+            self->ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+            self->ws_.read_message_max(kMaxMessageSize);
+            self->ws_.text(true);
+            self->ws_.async_accept(*safe_req, [self, safe_req](beast::error_code ec) {
+                self->OnAccept(ec);
+            });
+        });
+    }
+
+    void WebSocketSession::NotifyStateChanged() {
+        net::post(ws_.get_executor(), [self = shared_from_this()] {
+            self->state_changed_ = true;
+            self->Write();
+        });
+    }
+
+    void WebSocketSession::OnAccept(beast::error_code ec) {
+        if (ec) {
+            closed_ = true;
+            return;
+        }
+
+        hub_.Subscribe(player_.GetGameSession(), weak_from_this());
+
+        // Первым кадром клиент получает текущее состояние сессии
+        state_changed_ = true;
+        Write();
+        Read();
+    }
+
+    void WebSocketSession::Read() {
+        ws_.async_read(buffer_, beast::bind_front_handler(&WebSocketSession::OnRead, shared_from_this()));
+    }
+
+    void WebSocketSession::OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
+        if (ec) {
+            // В том числе websocket::error::closed - клиент закрыл соединение
+            closed_ = true;
+            return;
+        }
+
+        const std::string message = beast::buffers_to_string(buffer_.data());
+        buffer_.consume(buffer_.size());
+        HandleMessage(message);
+
+        if (!closed_) {
+            Read();
+        }
+    }
+
+    void WebSocketSession::HandleMessage(std::string_view message) {
+        auto dir = ApiRequestParser::ParseMove(message);
+        if (!dir) {
+            if (messages_.size() >= kMaxQueuedMessages) {
+                return Close(websocket::close_code::policy_error);
+            }
+            messages_.push_back(std::make_shared<const std::string>(ErrorMessages::invalidArgumentToParseAction));
+            return Write();
+        }
+
+        // Игровая модель меняется только на strand'е карты, как и при запросе /api/v1/game/player/action.
+        // Новое направление публикуется в снимке вместе с другими изменениями, стоящими в очереди strand'а
+        net::post(map_strand_, [self = shared_from_this(), dir = *dir] {
+            self->player_.SetDogMovementParameters(dir);
+            self->strands_.PublishChanges(self->player_.GetGameSession());
+        });
+    }
+
+    void WebSocketSession::Close(websocket::close_code code) {
+        closed_ = true;
+        messages_.clear();
+        // Закрытие может начаться, пока отправляется предыдущий кадр: поток дождётся его отправки
+        ws_.async_close(code, [self = shared_from_this()](beast::error_code) {
+        });
+    }
+
+    void WebSocketSession::Write() {
+        if (writing_ || closed_) {
+            return;
+        }
+
+        if (!messages_.empty()) {
+            auto message = std::move(messages_.front());
+            messages_.pop_front();
+
+            writing_ = true;
+            ws_.async_write(net::buffer(*message), [self = shared_from_this(), message](beast::error_code ec, std::size_t) {
+                self->OnWrite(ec);
+            });
+            return;
+        }
+
+        if (!state_changed_) {
+            return;
+        }
+        state_changed_ = false;
+
+        // Подписчики, получившие одну и ту же версию, получают один и тот же кадр из кэша сериализатора
+        auto state = state_serializer_.GetGameStateDelta(player_.GetGameSession(), sent_version_);
+        if (state->version == sent_version_) {
+            return;
+        }
+        sent_version_ = state->version;
+
+        writing_ = true;
+        ws_.async_write(net::buffer(state->text), [self = shared_from_this(), state](beast::error_code ec, std::size_t) {
+            self->OnWrite(ec);
+        });
+    }
+
+    void WebSocketSession::OnWrite(beast::error_code ec) {
+        writing_ = false;
+        if (ec) {
+            closed_ = true;
+            return;
+        }
+        Write();
+    }
+
+    void WebSocketHub::Accept(tcp::socket&& socket, http::request<http::string_body>&& req) {
+        std::string_view target = req.target();
+        if (target.substr(0, target.find('?')) != ApiRequestType::websocket) {
+            return WriteResponseAndClose(std::move(socket), MakeStringResponse(http::status::bad_request,
+                                                                              req.version(),
+                                                                              false,
+                                                                              ContentType::APPLICATION_JSON,
+                                                                              ErrorMessages::badRequest));
+        }
+
+        std::string user_token = ApiRequestParser::ParseBearer(req[http::field::authorization]);
+        if (user_token.empty()) {
+            return WriteResponseAndClose(std::move(socket), MakeStringResponse(http::status::unauthorized,
+                                                                              req.version(),
+                                                                              false,
+                                                                              ContentType::APPLICATION_JSON,
+                                                                              ErrorMessages::invalidToken));
+        }
+
+        model::Player* player = game_.FindPlayer(model::Player::Token{std::move(user_token)});
+        if (!player) {
+            return WriteResponseAndClose(std::move(socket), MakeStringResponse(http::status::unauthorized,
+                                                                              req.version(),
+                                                                              false,
+                                                                              ContentType::APPLICATION_JSON,
+                                                                              ErrorMessages::unknownToken));
+        }
+
+        std::make_shared<WebSocketSession>(std::move(socket), *this, *player, strands_, state_serializer_)
+                ->Run(std::move(req));
+    }
+
+    void WebSocketHub::NotifySubscribers(const model::GameSession* game_session) {
+        std::vector<std::shared_ptr<WebSocketSession>> sessions;
+        {
+            std::lock_guard lock{subscribers_mutex_};
+            auto it = subscribers_.find(game_session);
+            if (it == subscribers_.end()) {
+                return;
+            }
+            std::erase_if(it->second, [&sessions](const std::weak_ptr<WebSocketSession>& weak_session) {
+                if (auto session = weak_session.lock()) {
+                    sessions.push_back(std::move(session));
+                    return false;
+                }
+                return true;
+            });
+        }
+
+        for (const auto& session : sessions) {
+            session->NotifyStateChanged();
+        }
+    }
+
+    void WebSocketHub::Subscribe(const model::GameSession* game_session, std::weak_ptr<WebSocketSession> session) {
+        std::lock_guard lock{subscribers_mutex_};
+        subscribers_[game_session].push_back(std::move(session));
+    }
+}  // namespace http_handler
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "response_maker.h"
+#include "model.h"
+#include "api_strands.h"
+#include "game_state_serializer.h"
+
+#include <boost/beast/websocket.hpp>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace http_handler {
+    namespace net = boost::asio;
+    namespace beast = boost::beast;
+    namespace http = beast::http;
+    namespace websocket = beast::websocket;
+    using tcp = net::ip::tcp;
+
+    class WebSocketHub;
+
+    // WebSocket-соединение игрока. Принимает действия игрока кадрами {"move": "L"} и после каждого тика
+    // отправляет изменения состояния его игровой сессии в формате ответа /api/v1/game/state?since=.
+    // Все операции с потоком выполняются в strand'е соединения.
+    class WebSocketSession : public std::enable_shared_from_this<WebSocketSession> {
+    public:
+        // Столько ответов на некорректные кадры может ждать отправки. Клиент, который шлёт некорректные кадры
+        // и не принимает ответы, отключается, чтобы очередь не росла без ограничений
+        constexpr static std::size_t kMaxQueuedMessages = 16;
+
+        WebSocketSession(tcp::socket&& socket, WebSocketHub& hub, model::Player& player,
+                         const ApiStrands& strands, GameStateSerializer& state_serializer);
+
+        WebSocketSession(const WebSocketSession&) = delete;
+        WebSocketSession& operator=(const WebSocketSession&) = delete;
+
+        void Run(http::request<http::string_body>&& req);
+
+        // Сообщает, что состояние сессии изменилось. Может вызываться из любого потока
+        void NotifyStateChanged();
+
+    private:
+        websocket::stream<beast::tcp_stream> ws_;
+        beast::flat_buffer buffer_;
+        WebSocketHub& hub_;
+        model::Player& player_;
+        const ApiStrands& strands_;
+        const ApiStrands::Strand& map_strand_;
+        GameStateSerializer& state_serializer_;
+
+        // Ответы на некорректные кадры, отправляются раньше состояния
+        std::deque<std::shared_ptr<const std::string>> messages_;
+        // Состояние изменилось после последней отправки. Пока клиент не принял предыдущий кадр, тики
+        // не копятся в очереди: следующий кадр содержит все изменения с последней отправленной версии
+        bool state_changed_ = false;
+        bool writing_ = false;
+        bool closed_ = false;
+        // Версия состояния, отправленная клиенту последней; 0 - ничего не отправлено
+        uint64_t sent_version_ = 0;
+
+        void OnAccept(beast::error_code ec);
+
+        void Read();
+
+        void OnRead(beast::error_code ec, std::size_t bytes_read);
+
+        void HandleMessage(std::string_view message);
+
+        // Закрывает соединение с кодом code. Кадры после этого не отправляются и не читаются
+        void Close(websocket::close_code code);
+
+        void Write();
+
+        void OnWrite(beast::error_code ec);
+    };
+
+    // Принимает WebSocket-соединения игроков и рассылает им состояние после тиков игровых сессий
+    class WebSocketHub {
+    public:
+        WebSocketHub(model::Game& game, const ApiStrands& strands, GameStateSerializer& state_serializer)
+                : game_(game)
+                , strands_(strands)
+                , state_serializer_(state_serializer) {
+        }
+
+        WebSocketHub(const WebSocketHub&) = delete;
+        WebSocketHub& operator=(const WebSocketHub&) = delete;
+
+        // Проверяет путь и токен игрока из заголовка Authorization и переводит соединение на WebSocket.
+        // Если запрос некорректен, отвечает на него по HTTP и закрывает соединение
+        void Accept(tcp::socket&& socket, http::request<http::string_body>&& req);
+
+        // Уведомляет подписчиков сессии о новом состоянии. Вызывается после тика сессии
+        void NotifySubscribers(const model::GameSession* game_session);
+
+        void Subscribe(const model::GameSession* game_session, std::weak_ptr<WebSocketSession> session);
+
+    private:
+        model::Game& game_;
+        const ApiStrands& strands_;
+        GameStateSerializer& state_serializer_;
+
+        // Закрытые соединения удаляются из списка при следующей рассылке
+        std::mutex subscribers_mutex_;
+        std::unordered_map<const model::GameSession*, std::vector<std::weak_ptr<WebSocketSession>>> subscribers_;
+    };
+}  // namespace http_handler
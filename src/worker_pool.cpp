@@ -0,0 +1,83 @@
+#include "worker_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+namespace util {
+
+    namespace {
+
+        struct ParallelForState {
+            size_t count;
+            size_t parts_count;
+            const std::function<void(size_t, size_t, size_t)>* fn;
+
+            std::atomic<size_t> next_part{0};
+            size_t done_parts = 0;
+            std::exception_ptr error;
+            std::mutex mutex;
+            std::condition_variable all_done;
+
+            // Забирает и обрабатывает части, пока они не кончатся
+            void Run() {
+                size_t part;
+                while ((part = next_part.fetch_add(1)) < parts_count) {
+                    std::exception_ptr part_error;
+                    try {
+                        (*fn)(count * part / parts_count, count * (part + 1) / parts_count, part);
+                    } catch (...) {
+                        part_error = std::current_exception();
+                    }
+
+                    std::lock_guard lock{mutex};
+                    if (part_error && !error) {
+                        error = part_error;
+                    }
+                    if (++done_parts == parts_count) {
+                        all_done.notify_all();
+                    }
+                }
+            }
+        };
+
+    }  // namespace
+
+    size_t WorkerPool::GetPartsCount(size_t count) const noexcept {
+        return std::min(count, static_cast<size_t>(thread_count_) * PARTS_PER_THREAD);
+    }
+
+    void WorkerPool::ParallelFor(size_t count, const std::function<void(size_t, size_t, size_t)>& fn) {
+        const size_t parts_count = GetPartsCount(count);
+        if (parts_count == 0) {
+            return;
+        }
+
+        auto state = std::make_shared<ParallelForState>();
+        state->count = count;
+        state->parts_count = parts_count;
+        state->fn = &fn;
+
+        // Помощник, запущенный после окончания работы, не найдёт свободных частей и не тронет fn
+        const size_t helpers = std::min(parts_count, static_cast<size_t>(thread_count_)) - 1;
+        for (size_t i = 0; i < helpers; ++i) {
+            net::post(pool_, [state] {
+                state->Run();
+            });
+        }
+
+        state->Run();
+
+        std::unique_lock lock{state->mutex};
+        state->all_done.wait(lock, [&state] {
+            return state->done_parts == state->parts_count;
+        });
+
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+}  // namespace util
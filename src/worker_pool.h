@@ -0,0 +1,51 @@
+#pragma once
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include <algorithm>
+#include <functional>
+
+namespace util {
+    namespace net = boost::asio;
+
+    // Пул потоков для параллельных вычислений внутри тика
+    class WorkerPool {
+    public:
+        explicit WorkerPool(unsigned thread_count)
+                : thread_count_(std::max(1u, thread_count))
+                , pool_(thread_count_) {
+        }
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        ~WorkerPool() {
+            pool_.join();
+        }
+
+        unsigned GetThreadCount() const noexcept {
+            return thread_count_;
+        }
+
+        net::thread_pool::executor_type GetExecutor() noexcept {
+            return pool_.get_executor();
+        }
+
+        // Делит [0, count) на части и вызывает fn(begin, end, part) для каждой части, part < GetPartsCount(count).
+        // Возвращает управление, когда обработаны все части. Вызывающий поток тоже обрабатывает части,
+        // а ждёт только те, которые уже выполняются, поэтому вложенные вызовы ParallelFor не блокируют друг друга.
+        // Первое исключение из fn пробрасывается вызывающему.
+        void ParallelFor(size_t count, const std::function<void(size_t begin, size_t end, size_t part)>& fn);
+
+        size_t GetPartsCount(size_t count) const noexcept;
+
+    private:
+        // На каждый поток приходится несколько частей, чтобы неравномерная работа распределялась лучше
+        constexpr static size_t PARTS_PER_THREAD = 4;
+
+        unsigned thread_count_;
+        net::thread_pool pool_;
+    };
+
+}  // namespace util
@@ -0,0 +1,157 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "binary_writer.h"
+#include "game_state_serializer.h"
+#include "model.h"
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace model;
+using namespace std::literals;
+
+using http_handler::BinaryWriter;
+using http_handler::GameStateSerializer;
+
+namespace {
+    // Читает двоичный ответ по порядку полей, проверяя, что данные не кончились раньше времени
+    class BinaryReader {
+    public:
+        explicit BinaryReader(std::string_view data)
+                : data_(data) {
+        }
+
+        template <typename T>
+        T Read() {
+            REQUIRE(data_.size() >= sizeof(T));
+            // Формат little-endian, как и платформы, на которых собирается сервер
+            T value;
+            std::memcpy(&value, data_.data(), sizeof(T));
+            data_.remove_prefix(sizeof(T));
+            return value;
+        }
+
+        double ReadCoord() {
+            return Read<std::int32_t>() / BinaryWriter::kCoordScale;
+        }
+
+        bool IsEnd() const {
+            return data_.empty();
+        }
+
+    private:
+        std::string_view data_;
+    };
+
+    struct DecodedDog {
+        std::uint32_t id;
+        Position pos;
+        std::uint32_t score;
+        std::uint8_t dir;
+        Dog::LootsIdAndType bag;
+    };
+
+    struct DecodedState {
+        std::uint64_t version;
+        std::vector<DecodedDog> dogs;
+        std::uint32_t lost_objects_count;
+    };
+
+    DecodedState DecodeState(std::string_view body) {
+        BinaryReader reader{body};
+        CHECK(reader.Read<std::uint8_t>() == static_cast<std::uint8_t>(BinaryWriter::Kind::state));
+        CHECK(reader.Read<std::uint8_t>() == BinaryWriter::kFormat);
+        CHECK(reader.Read<std::uint16_t>() == 0);
+
+        const auto dogs_count = reader.Read<std::uint32_t>();
+        const auto bag_items_count = reader.Read<std::uint32_t>();
+        DecodedState state;
+        state.lost_objects_count = reader.Read<std::uint32_t>();
+        state.version = reader.Read<std::uint64_t>();
+
+        std::vector<std::uint32_t> bag_sizes;
+        for (std::uint32_t i = 0; i < dogs_count; ++i) {
+            DecodedDog dog;
+            dog.id = reader.Read<std::uint32_t>();
+            dog.pos.x = reader.ReadCoord();
+            dog.pos.y = reader.ReadCoord();
+            reader.ReadCoord();
+            reader.ReadCoord();
+            dog.score = reader.Read<std::uint32_t>();
+            bag_sizes.push_back(reader.Read<std::uint32_t>());
+            dog.dir = reader.Read<std::uint8_t>();
+            CHECK(reader.Read<std::uint8_t>() == 0);
+            CHECK(reader.Read<std::uint16_t>() == 0);
+            state.dogs.push_back(std::move(dog));
+        }
+
+        std::uint32_t bag_items_read = 0;
+        for (std::uint32_t i = 0; i < dogs_count; ++i) {
+            for (std::uint32_t j = 0; j < bag_sizes[i]; ++j) {
+                const auto id = reader.Read<std::uint32_t>();
+                const auto type = reader.Read<std::uint32_t>();
+                state.dogs[i].bag.emplace_back(id, type);
+                ++bag_items_read;
+            }
+        }
+        CHECK(bag_items_read == bag_items_count);
+
+        for (std::uint32_t i = 0; i < state.lost_objects_count; ++i) {
+            for (int field = 0; field < 4; ++field) {
+                reader.Read<std::uint32_t>();
+            }
+        }
+        CHECK(reader.IsEnd());
+
+        return state;
+    }
+}  // namespace
+
+TEST_CASE("Binary state round-trips dogs with full bags", "[BinaryWriter]") {
+    // Рюкзак вмещает больше предметов, чем помещается в байт
+    constexpr unsigned bag_capacity = 300;
+    Map map{Map::Id{"test"s}, "Test map"s, 1., {{0, 10}, {1, 20}}, bag_capacity};
+    map.AddRoad(Road{Road::HORIZONTAL, {0, 0}, 10});
+    map.SetRoadGraph(RoadGraph{map.GetRoads()});
+
+    // Без офисов и движения собаки ничего не сдают и не подбирают, и рюкзаки остаются такими, как их заполнили
+    GameSession session{&map, false, 1000., 0.};
+    std::deque<Dog> dogs;
+    for (unsigned id = 0; id < 3; ++id) {
+        session.AddDog(&dogs.emplace_back("dog"s + std::to_string(id), id + 10));
+    }
+
+    size_t loot_id = 0;
+    for (unsigned i = 0; i < bag_capacity; ++i) {
+        dogs[0].AddToBackpack(loot_id++, i % 2);
+    }
+    dogs[1].AddToBackpack(loot_id++, 1);
+    dogs[1].AddToBackpack(loot_id++, 0);
+    dogs[2].AddToTheScore(70'000);
+    session.SetTimeShift(0.);
+
+    GameStateSerializer serializer;
+    const auto snapshot = session.GetSnapshot();
+    const auto body = serializer.GetGameStateBinary(&session);
+    REQUIRE(body->version == snapshot->version);
+
+    const auto state = DecodeState(body->text);
+    CHECK(state.version == snapshot->version);
+    CHECK(state.lost_objects_count == snapshot->lost_objects->size());
+    REQUIRE(state.dogs.size() == snapshot->dogs.size());
+    for (size_t slot = 0; slot < state.dogs.size(); ++slot) {
+        const auto& expected = *snapshot->dogs[slot];
+        const auto& dog = state.dogs[slot];
+        INFO("slot " << slot);
+        CHECK(dog.id == expected.id);
+        CHECK(dog.pos == expected.pos);
+        CHECK(dog.score == expected.score);
+        CHECK(dog.dir == 0);
+        CHECK(dog.bag == expected.bag);
+    }
+    CHECK(state.dogs[0].bag.size() == bag_capacity);
+}
@@ -0,0 +1,295 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "collision_batch.h"
+#include "collision_detector.h"
+#include "collision_world.h"
+#include "worker_pool.h"
+
+#include <bit>
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <set>
+#include <span>
+#include <vector>
+
+using namespace collision_detector;
+
+namespace {
+    // Числа сравниваются побитово: векторные реализации обязаны считать в точности как скалярная
+    struct EventBits {
+        size_t item_id;
+        size_t gatherer_id;
+        std::uint64_t sq_distance;
+        std::uint64_t time;
+
+        explicit EventBits(const GatheringEvent& event)
+                : item_id(event.item_id)
+                , gatherer_id(event.gatherer_id)
+                , sq_distance(std::bit_cast<std::uint64_t>(event.sq_distance))
+                , time(std::bit_cast<std::uint64_t>(event.time)) {
+        }
+
+        bool operator==(const EventBits&) const = default;
+    };
+
+    std::ostream& operator<<(std::ostream& out, const EventBits& event) {
+        return out << "{item: " << event.item_id << ", gatherer: " << event.gatherer_id
+                   << ", sq_distance: " << std::bit_cast<double>(event.sq_distance)
+                   << ", time: " << std::bit_cast<double>(event.time) << '}';
+    }
+
+    std::vector<EventBits> ToBits(const std::vector<GatheringEvent>& events) {
+        return {events.begin(), events.end()};
+    }
+
+    // Координаты на сетке с шагом 0.1 дают много попаданий ровно на границу радиуса и концы отрезка
+    double RandomCoord(std::mt19937& random, int max) {
+        return std::uniform_int_distribution<int>(0, max * 10)(random) / 10.;
+    }
+
+    Gatherer RandomGatherer(std::mt19937& random) {
+        Gatherer gatherer;
+        do {
+            gatherer = {{RandomCoord(random, 10), RandomCoord(random, 10)},
+                        {RandomCoord(random, 10), RandomCoord(random, 10)},
+                        RandomCoord(random, 1)};
+        } while (IsZeroMove(gatherer));
+        return gatherer;
+    }
+
+    // Предметы и сборщики для сравнения сетки с полным перебором. Часть предметов лежит ровно на границах ячеек
+    // и шире ячейки, часть сборщиков стоит на месте.
+    class RandomScene {
+    public:
+        constexpr static int SIZE = 20;
+
+        explicit RandomScene(unsigned seed)
+                : random_(seed) {
+        }
+
+        Item MakeItem() {
+            const double width = std::bernoulli_distribution(0.1)(random_)
+                                 ? ItemGrid::DEFAULT_CELL_SIZE * (1. + RandomCoord(random_, 2))
+                                 : RandomCoord(random_, 1);
+            if (std::bernoulli_distribution(0.3)(random_)) {
+                return {{CellBorder(), CellBorder()}, width};
+            }
+            return {{Coord(), Coord()}, width};
+        }
+
+        Gatherer MakeGatherer() {
+            const geom::Point2D start{Coord(), Coord()};
+            const double width = RandomCoord(random_, 1);
+            switch (std::uniform_int_distribution<int>(0, 4)(random_)) {
+                case 0:
+                    return {start, start, width};
+                case 1: {
+                    // Вдоль границы ячеек
+                    const double border = CellBorder();
+                    return {{border, start.y}, {border, Coord()}, width};
+                }
+                default:
+                    return {start, {Coord(), Coord()}, width};
+            }
+        }
+
+        std::mt19937& Random() {
+            return random_;
+        }
+
+    private:
+        std::mt19937 random_;
+
+        // Отрицательные координаты тоже встречаются: ключ ячейки строится из знаковых номеров
+        double Coord() {
+            return RandomCoord(random_, SIZE) - SIZE / 2.;
+        }
+
+        double CellBorder() {
+            const int cells = static_cast<int>(SIZE / ItemGrid::DEFAULT_CELL_SIZE);
+            return std::uniform_int_distribution<int>(-cells / 2, cells / 2)(random_) * ItemGrid::DEFAULT_CELL_SIZE;
+        }
+    };
+}  // namespace
+
+TEST_CASE("Batch kernels match the scalar kernel bit for bit", "[CollectItemsBatch]") {
+    std::mt19937 random{42};
+    std::uniform_int_distribution<size_t> count_dist(0, 37);
+
+    for (int round = 0; round < 2'000; ++round) {
+        // Число предметов не всегда кратно числу дорожек, чтобы проверить и добор хвоста
+        ItemsSoA items;
+        const size_t items_count = count_dist(random);
+        for (size_t i = 0; i < items_count; ++i) {
+            items.PushBack({{RandomCoord(random, 10), RandomCoord(random, 10)}, RandomCoord(random, 1)});
+        }
+        const Gatherer gatherer = RandomGatherer(random);
+
+        std::vector<GatheringEvent> expected;
+        CollectItemsBatch(gatherer, 3, items, expected, BatchKernel::SCALAR);
+
+        for (BatchKernel kernel : {BatchKernel::SSE2, BatchKernel::AVX2}) {
+            if (!IsBatchKernelSupported(kernel)) {
+                continue;
+            }
+            INFO("round " << round << ", kernel " << static_cast<int>(kernel));
+            std::vector<GatheringEvent> events;
+            CollectItemsBatch(gatherer, 3, items, events, kernel);
+            REQUIRE(ToBits(events) == ToBits(expected));
+        }
+
+        std::vector<GatheringEvent> selected;
+        CollectItemsBatch(gatherer, 3, items, selected);
+        REQUIRE(ToBits(selected) == ToBits(expected));
+    }
+}
+
+TEST_CASE("Scalar batch kernel matches TryGatherItem", "[CollectItemsBatch]") {
+    std::mt19937 random{7};
+
+    for (int round = 0; round < 500; ++round) {
+        ItemsSoA items;
+        for (size_t i = 0; i < 16; ++i) {
+            items.PushBack({{RandomCoord(random, 10), RandomCoord(random, 10)}, RandomCoord(random, 1)});
+        }
+        const Gatherer gatherer = RandomGatherer(random);
+
+        std::vector<GatheringEvent> expected;
+        for (size_t i = 0; i < items.Size(); ++i) {
+            TryGatherItem(gatherer, 0, items.Get(i), i, expected);
+        }
+
+        std::vector<GatheringEvent> events;
+        CollectItemsBatch(gatherer, 0, items, events, BatchKernel::SCALAR);
+        REQUIRE(ToBits(events) == ToBits(expected));
+    }
+}
+
+TEST_CASE("Uniform grid finds the same events as brute force", "[FindGatherEvents]") {
+    RandomScene scene{42};
+    std::uniform_int_distribution<size_t> count_dist(0, 60);
+    size_t events_count = 0;
+
+    for (int round = 0; round < 500; ++round) {
+        std::vector<Item> items(count_dist(scene.Random()));
+        for (auto& item : items) {
+            item = scene.MakeItem();
+        }
+        std::vector<Gatherer> gatherers(count_dist(scene.Random()) / 4);
+        for (auto& gatherer : gatherers) {
+            gatherer = scene.MakeGatherer();
+        }
+
+        const SpanItemGathererProvider provider{items, gatherers};
+        const auto expected = FindGatherEvents(provider, Engine::BRUTE_FORCE);
+        INFO("round " << round);
+        REQUIRE(ToBits(FindGatherEvents(provider, Engine::UNIFORM_GRID)) == ToBits(expected));
+        events_count += expected.size();
+    }
+    CHECK(events_count > 0);
+}
+
+TEST_CASE("CollisionWorld grid follows brute force as items come and go", "[CollisionWorld]") {
+    RandomScene scene{7};
+    CollisionWorld grid_world{Engine::UNIFORM_GRID};
+    CollisionWorld brute_world{Engine::BRUTE_FORCE};
+    std::vector<Item> items;
+    std::vector<Gatherer> gatherers;
+    size_t events_count = 0;
+
+    for (int i = 0; i < 12; ++i) {
+        gatherers.push_back(scene.MakeGatherer());
+        grid_world.AddGatherer(gatherers.back());
+        brute_world.AddGatherer(gatherers.back());
+    }
+
+    for (int round = 0; round < 500; ++round) {
+        // Предметы появляются и подбираются, как в игре: удалённый заменяется последним
+        for (int i = std::uniform_int_distribution<int>(0, 5)(scene.Random()); i > 0; --i) {
+            items.push_back(scene.MakeItem());
+            grid_world.AddItem(items.back());
+            brute_world.AddItem(items.back());
+        }
+        for (int i = std::uniform_int_distribution<int>(0, 4)(scene.Random()); i > 0 && !items.empty(); --i) {
+            const size_t idx = std::uniform_int_distribution<size_t>(0, items.size() - 1)(scene.Random());
+            REQUIRE(grid_world.RemoveItem(idx) == items.size() - 1);
+            brute_world.RemoveItem(idx);
+            items[idx] = items.back();
+            items.pop_back();
+        }
+        for (size_t g = 0; g < gatherers.size(); ++g) {
+            gatherers[g] = scene.MakeGatherer();
+            grid_world.SetGatherer(g, gatherers[g]);
+            brute_world.SetGatherer(g, gatherers[g]);
+        }
+
+        const auto expected = ToBits(FindGatherEvents(SpanItemGathererProvider{items, gatherers}));
+        INFO("round " << round << ", items " << items.size());
+        REQUIRE(ToBits(brute_world.FindGatherEvents()) == expected);
+        REQUIRE(ToBits(grid_world.FindGatherEvents()) == expected);
+        events_count += expected.size();
+    }
+    CHECK(events_count > 0);
+}
+
+TEST_CASE("Parallel search finds the same events as the serial one", "[FindGatherEvents][parallel]") {
+    RandomScene scene{3};
+    // Сцена плотная, поэтому одни и те же предметы подбирают сборщики из разных частей
+    constexpr size_t GATHERERS_COUNT = 200;
+    std::vector<Item> items;
+    for (int i = 0; i < 300; ++i) {
+        items.push_back(scene.MakeItem());
+    }
+    std::vector<Gatherer> gatherers;
+    for (size_t i = 0; i < GATHERERS_COUNT; ++i) {
+        gatherers.push_back(scene.MakeGatherer());
+    }
+    const SpanItemGathererProvider provider{items, gatherers};
+
+    for (unsigned threads : {2u, 4u}) {
+        util::WorkerPool pool{threads};
+        // При нулевом пороге параллельно ищутся события даже одного сборщика
+        const ParallelOptions parallel{&pool, 0};
+        REQUIRE(pool.GetPartsCount(GATHERERS_COUNT) > 1);
+
+        for (Engine engine : {Engine::BRUTE_FORCE, Engine::UNIFORM_GRID}) {
+            INFO("threads " << threads << ", engine " << static_cast<int>(engine));
+            REQUIRE(parallel.IsParallel(engine, GATHERERS_COUNT, items.size()));
+            const auto expected = FindGatherEvents(provider, engine);
+
+            // Проверяем, что хотя бы один предмет подбирают сборщики из первой и последней частей
+            std::set<size_t> first_part_items;
+            bool shared_item = false;
+            const size_t part_size = GATHERERS_COUNT / pool.GetPartsCount(GATHERERS_COUNT);
+            for (const auto& event : expected) {
+                if (event.gatherer_id < part_size) {
+                    first_part_items.insert(event.item_id);
+                }
+            }
+            for (const auto& event : expected) {
+                shared_item = shared_item || (event.gatherer_id >= GATHERERS_COUNT - part_size
+                                              && first_part_items.contains(event.item_id));
+            }
+            CHECK(shared_item);
+
+            REQUIRE(ToBits(FindGatherEvents(provider, engine, parallel)) == ToBits(expected));
+
+            CollisionWorld world{engine, parallel};
+            for (const auto& item : items) {
+                world.AddItem(item);
+            }
+            for (const auto& gatherer : gatherers) {
+                world.AddGatherer(gatherer);
+            }
+            // Буферы частей переиспользуются между вызовами, результат от этого меняться не должен
+            for (int call = 0; call < 3; ++call) {
+                REQUIRE(ToBits(world.FindGatherEvents()) == ToBits(expected));
+            }
+
+            // Один сборщик: частей меньше, чем потоков
+            const SpanItemGathererProvider single{items, std::span{gatherers}.first(1)};
+            REQUIRE(ToBits(FindGatherEvents(single, engine, parallel)) == ToBits(FindGatherEvents(single, engine)));
+        }
+    }
+}
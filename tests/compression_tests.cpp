@@ -0,0 +1,51 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "compression.h"
+#include "game_state_serializer.h"
+
+using http_handler::IsGzipAccepted;
+
+TEST_CASE("Accept-Encoding negotiates gzip", "[compression]") {
+    SECTION("gzip listed with a non-zero weight") {
+        CHECK(IsGzipAccepted("gzip"));
+        CHECK(IsGzipAccepted("deflate, gzip;q=0.5"));
+        CHECK(IsGzipAccepted("x-gzip"));
+        CHECK(IsGzipAccepted("GZIP, br"));
+    }
+
+    SECTION("gzip refused or not listed") {
+        CHECK_FALSE(IsGzipAccepted(""));
+        CHECK_FALSE(IsGzipAccepted("identity"));
+        CHECK_FALSE(IsGzipAccepted("gzip;q=0"));
+        CHECK_FALSE(IsGzipAccepted("gzip; q=0.000"));
+    }
+
+    SECTION("an explicit gzip weight overrides *") {
+        CHECK(IsGzipAccepted("br, *"));
+        CHECK_FALSE(IsGzipAccepted("*;q=0"));
+        CHECK_FALSE(IsGzipAccepted("gzip;q=0, *"));
+        CHECK_FALSE(IsGzipAccepted("*, gzip;q=0"));
+        CHECK(IsGzipAccepted("gzip, *;q=0"));
+        // x-gzip - то же самое, что gzip
+        CHECK(IsGzipAccepted("gzip;q=0, x-gzip"));
+    }
+}
+
+TEST_CASE("State bodies shorter than gzip-min-size are not compressed", "[compression]") {
+    const http_handler::CompressionOptions compression;
+
+    http_handler::GameStateSerializer::SerializedState small;
+    small.text = R"({"version":2,"full":false,"players":{},"lostObjects":{},"removedLostObjects":[]})";
+    REQUIRE(small.text.size() < compression.min_dynamic_size);
+    CHECK_FALSE(small.GetGzipBody(compression));
+
+    http_handler::GameStateSerializer::SerializedState large;
+    while (large.text.size() < compression.min_dynamic_size * 4) {
+        large.text += R"({"pos":[1E0,2E0],"speed":[0E0,0E0],"dir":"U","bag":[],"score":0})";
+    }
+    const auto gzip_body = large.GetGzipBody(compression);
+    REQUIRE(gzip_body);
+    CHECK(gzip_body->size() < large.text.size());
+    // Сжатое тело одно на версию
+    CHECK(large.GetGzipBody(compression) == gzip_body);
+}
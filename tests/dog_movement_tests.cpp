@@ -0,0 +1,402 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "model.h"
+
+#include <cmath>
+#include <ostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace model;
+
+namespace {
+    constexpr double kDistanceFromRoadAxisToBoundary = 0.4;
+    constexpr double kDogSpeed = 1.;
+
+    // Состояние собаки, которое изменяет перемещение
+    struct DogMovement {
+        Position pos;
+        Speed speed;
+        Direction dir = Direction::UP;
+        RoadGraph::CorridorId corridor = RoadGraph::NO_CORRIDOR;
+
+        bool operator==(const DogMovement&) const = default;
+    };
+
+    std::ostream& operator<<(std::ostream& out, const DogMovement& dog) {
+        return out << "{pos: (" << dog.pos.x << ", " << dog.pos.y << "), speed: (" << dog.speed.horizontal << ", "
+                   << dog.speed.vertical << "), dir: " << static_cast<int>(dog.dir) << ", corridor: " << dog.corridor << '}';
+    }
+
+    Speed GetSpeed(Direction dir) {
+        switch (dir) {
+            case Direction::UP:
+                return {0., -kDogSpeed};
+            case Direction::DOWN:
+                return {0., kDogSpeed};
+            case Direction::LEFT:
+                return {-kDogSpeed, 0.};
+            case Direction::RIGHT:
+                return {kDogSpeed, 0.};
+            case Direction::STOP:
+                break;
+        }
+        return {};
+    }
+
+    // Перемещение собаки до введения GameSession::MoveDog: отдельная функция на каждое направление.
+    // Перенесено без изменений логики, вместо методов Dog состояние меняется напрямую
+    namespace reference {
+        void MoveDogRight(const RoadGraph& road_graph, double shift_time, DogMovement& dog) {
+            RoadGraph::CorridorId& corridor_id = dog.corridor;
+            auto pos = dog.pos;
+            auto speed = dog.speed;
+
+            double distance = shift_time * speed.horizontal;
+
+            while (true) {
+                double road_edge_coordinate = road_graph.GetCorridor(corridor_id).GetEnd().x + kDistanceFromRoadAxisToBoundary;
+
+                if (GameSession::LessOrEqual(distance + pos.x, road_edge_coordinate)) {
+                    dog.pos = {distance + pos.x, pos.y};
+
+                    if (GameSession::CheckEqualityDouble(distance + pos.x, road_edge_coordinate)) {
+                        dog.speed = {};
+                    }
+
+                    return;
+                }
+
+                distance -= road_edge_coordinate - pos.x;
+                pos.x = road_edge_coordinate;
+
+                auto next_corridor = road_graph.GetNextCorridor(corridor_id, Direction::RIGHT, GameSession::RoundCoord(pos.y));
+                if (next_corridor == RoadGraph::NO_CORRIDOR) {
+                    dog.pos = {pos.x, pos.y};
+                    dog.speed = {};
+                    return;
+                }
+                corridor_id = next_corridor;
+            }
+        }
+
+        void MoveDogLeft(const RoadGraph& road_graph, double shift_time, DogMovement& dog) {
+            RoadGraph::CorridorId& corridor_id = dog.corridor;
+            auto pos = dog.pos;
+            auto speed = dog.speed;
+
+            double distance = shift_time * speed.horizontal;
+
+            while (true) {
+                double road_edge_coordinate = road_graph.GetCorridor(corridor_id).GetStart().x - kDistanceFromRoadAxisToBoundary;
+
+                if (GameSession::LessOrEqual(road_edge_coordinate, distance + pos.x)) {
+                    dog.pos = {distance + pos.x, pos.y};
+
+                    if (GameSession::CheckEqualityDouble(distance + pos.x, road_edge_coordinate)) {
+                        dog.speed = {};
+                    }
+
+                    return;
+                }
+
+                distance -= road_edge_coordinate - pos.x;
+                pos.x = road_edge_coordinate;
+
+                auto next_corridor = road_graph.GetNextCorridor(corridor_id, Direction::LEFT, GameSession::RoundCoord(pos.y));
+                if (next_corridor == RoadGraph::NO_CORRIDOR) {
+                    dog.pos = {pos.x, pos.y};
+                    dog.speed = {};
+                    return;
+                }
+                corridor_id = next_corridor;
+            }
+        }
+
+        void MoveDogUp(const RoadGraph& road_graph, double shift_time, DogMovement& dog) {
+            RoadGraph::CorridorId& corridor_id = dog.corridor;
+            auto pos = dog.pos;
+            auto speed = dog.speed;
+
+            double distance = shift_time * speed.vertical;
+
+            while (true) {
+                double road_edge_coordinate = road_graph.GetCorridor(corridor_id).GetStart().y - kDistanceFromRoadAxisToBoundary;
+
+                if (GameSession::LessOrEqual(road_edge_coordinate, distance + pos.y)) {
+                    dog.pos = {pos.x, distance + pos.y};
+
+                    if (GameSession::CheckEqualityDouble(distance + pos.y, road_edge_coordinate)) {
+                        dog.speed = {};
+                    }
+
+                    return;
+                }
+
+                distance -= road_edge_coordinate - pos.y;
+                pos.y = road_edge_coordinate;
+
+                auto next_corridor = road_graph.GetNextCorridor(corridor_id, Direction::UP, GameSession::RoundCoord(pos.x));
+                if (next_corridor == RoadGraph::NO_CORRIDOR) {
+                    dog.pos = {pos.x, pos.y};
+                    dog.speed = {};
+                    return;
+                }
+                corridor_id = next_corridor;
+            }
+        }
+
+        void MoveDogDown(const RoadGraph& road_graph, double shift_time, DogMovement& dog) {
+            RoadGraph::CorridorId& corridor_id = dog.corridor;
+            auto pos = dog.pos;
+            auto speed = dog.speed;
+
+            double distance = shift_time * speed.vertical;
+
+            while (true) {
+                double road_edge_coordinate = road_graph.GetCorridor(corridor_id).GetEnd().y + kDistanceFromRoadAxisToBoundary;
+
+                if (GameSession::LessOrEqual(distance + pos.y, road_edge_coordinate)) {
+                    dog.pos = {pos.x, distance + pos.y};
+
+                    if (GameSession::CheckEqualityDouble(distance + pos.y, road_edge_coordinate)) {
+                        dog.speed = {};
+                    }
+
+                    return;
+                }
+
+                distance -= road_edge_coordinate - pos.y;
+                pos.y = road_edge_coordinate;
+
+                auto next_corridor = road_graph.GetNextCorridor(corridor_id, Direction::DOWN, GameSession::RoundCoord(pos.x));
+                if (next_corridor == RoadGraph::NO_CORRIDOR) {
+                    dog.pos = {pos.x, pos.y};
+                    dog.speed = {};
+                    return;
+                }
+                corridor_id = next_corridor;
+            }
+        }
+
+        void MoveDog(const RoadGraph& road_graph, double shift_time, DogMovement& dog) {
+            switch (dog.dir) {
+                case Direction::RIGHT:
+                    MoveDogRight(road_graph, shift_time, dog);
+                    break;
+                case Direction::LEFT:
+                    MoveDogLeft(road_graph, shift_time, dog);
+                    break;
+                case Direction::UP:
+                    MoveDogUp(road_graph, shift_time, dog);
+                    break;
+                case Direction::DOWN:
+                    MoveDogDown(road_graph, shift_time, dog);
+                    break;
+                case Direction::STOP:
+                    break;
+            }
+        }
+    }  // namespace reference
+
+    void MoveDog(const RoadGraph& road_graph, double shift_time, DogMovement& dog) {
+        GameSession::MoveDog(road_graph, shift_time, dog.dir, dog.pos, dog.speed, dog.corridor);
+    }
+
+    // Собака на дороге road, идущая в направлении dir
+    DogMovement MakeDog(const RoadGraph& road_graph, RoadGraph::RoadId road, Position pos, Direction dir) {
+        return {pos, GetSpeed(dir), dir, road_graph.GetCorridorOfRoad(road)};
+    }
+
+    // Сравнивает новое и прежнее перемещение собаки dog и возвращает результат
+    DogMovement CheckMove(const RoadGraph& road_graph, double shift_time, const DogMovement& dog) {
+        DogMovement expected = dog;
+        reference::MoveDog(road_graph, shift_time, expected);
+
+        DogMovement actual = dog;
+        MoveDog(road_graph, shift_time, actual);
+
+        INFO("from " << dog << " for " << shift_time);
+        CHECK(actual == expected);
+        return actual;
+    }
+
+    // Квадрат со стороной 10 и крестом дорог в середине. Горизонтальная дорога (0, 5) - (20, 5)
+    // выходит за квадрат, а (10, 0) - (2, 0) задана справа налево и перекрывает (0, 0) - (4, 0)
+    RoadGraph MakeRoadGraph() {
+        return RoadGraph{{
+                Road{Road::HORIZONTAL, {0, 0}, 4},
+                Road{Road::HORIZONTAL, {10, 0}, 2},
+                Road{Road::VERTICAL, {10, 0}, 10},
+                Road{Road::HORIZONTAL, {10, 10}, 0},
+                Road{Road::VERTICAL, {0, 10}, 0},
+                Road{Road::HORIZONTAL, {0, 5}, 20},
+                Road{Road::VERTICAL, {5, 0}, 10},
+        }};
+    }
+
+    // Сетка size x size клеток со стороной step
+    RoadGraph MakeGridRoadGraph(int size, int step) {
+        std::vector<Road> roads;
+        for (int i = 0; i <= size; ++i) {
+            roads.emplace_back(Road::HORIZONTAL, Point{0, i * step}, size * step);
+            roads.emplace_back(Road::VERTICAL, Point{i * step, 0}, size * step);
+        }
+        return RoadGraph{roads};
+    }
+
+    // Случайные собаки на перекрёстках и серединах дорог сетки
+    std::vector<DogMovement> MakeGridDogs(const RoadGraph& road_graph, size_t count, int size, int step, std::mt19937& random) {
+        std::uniform_int_distribution<RoadGraph::RoadId> road_dist(0, road_graph.GetRoadsCount() - 1);
+        std::uniform_int_distribution<int> point_dist(0, size * 2);
+        std::uniform_int_distribution<int> dir_dist(0, 3);
+
+        std::vector<DogMovement> dogs;
+        dogs.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            const auto road_id = road_dist(random);
+            const Road& road = road_graph.GetRoad(road_id);
+            const double along = point_dist(random) * step / 2.;
+            Position pos = road.IsHorizontal() ? Position{along, static_cast<double>(road.GetStart().y)}
+                                               : Position{static_cast<double>(road.GetStart().x), along};
+            dogs.push_back(MakeDog(road_graph, road_id, pos, static_cast<Direction>(dir_dist(random))));
+        }
+        return dogs;
+    }
+}  // namespace
+
+TEST_CASE("MoveDog stops at a dead end like the old MoveDog functions", "[MoveDog]") {
+    const RoadGraph road_graph = MakeRoadGraph();
+
+    // Дорога (0, 5) - (20, 5): справа тупик на x = 20.4
+    const auto road = 5;
+    for (double shift_time : {0., 0.5, 5.4 - 1e-7, 5.4, 5.4 + 1e-7, 5.4 + 1e-5, 6., 100.}) {
+        auto dog = CheckMove(road_graph, shift_time, MakeDog(road_graph, road, {15., 5.}, Direction::RIGHT));
+        // Собака, дошедшая до границы с точностью до эпсилон, останавливается
+        if (shift_time >= 5.4 - 1e-6) {
+            CHECK(dog.speed == Speed{});
+            // Остановившаяся собака сохраняет направление
+            CHECK(dog.dir == Direction::RIGHT);
+        }
+        if (shift_time > 5.4 + 1e-6) {
+            CHECK(dog.pos == Position{20.4, 5.});
+        }
+    }
+
+    // Во все стороны от углов квадрата
+    using Corner = std::pair<Position, RoadGraph::RoadId>;
+    for (auto [pos, road_id] : {Corner{{0., 0.}, 0}, Corner{{10., 10.}, 3}, Corner{{10., 0.}, 2}, Corner{{0., 10.}, 4}}) {
+        for (auto dir : {Direction::LEFT, Direction::RIGHT, Direction::UP, Direction::DOWN}) {
+            for (double shift_time : {0.2, 0.4, 0.4 + 1e-7, 0.41, 3., 10.4, 10.4 - 1e-7, 10.8, 25.}) {
+                CheckMove(road_graph, shift_time, MakeDog(road_graph, road_id, pos, dir));
+            }
+        }
+    }
+}
+
+TEST_CASE("MoveDog keeps a stopped dog in place", "[MoveDog]") {
+    const RoadGraph road_graph = MakeRoadGraph();
+
+    // Собака, упёршаяся в границу, стоит на месте и не меняет коридор
+    auto dog = MakeDog(road_graph, 3, {-0.4, 10.}, Direction::LEFT);
+    dog.speed = {};
+    CHECK(CheckMove(road_graph, 10., dog) == dog);
+
+    // Направление STOP не сдвигает собаку, даже если скорость не обнулена
+    dog = MakeDog(road_graph, 5, {7., 5.}, Direction::RIGHT);
+    dog.dir = Direction::STOP;
+    CHECK(CheckMove(road_graph, 10., dog) == dog);
+
+    // Собака, стоящая точно на границе, снова останавливается на ней
+    dog = MakeDog(road_graph, 2, {10., 10.4}, Direction::DOWN);
+    CHECK(CheckMove(road_graph, 1., dog).speed == Speed{});
+}
+
+TEST_CASE("MoveDog passes crossings like the old MoveDog functions", "[MoveDog]") {
+    const RoadGraph road_graph = MakeRoadGraph();
+
+    // С перекрывающихся дорог (0, 0) - (4, 0) и (2, 0) - (10, 0) в один ход до вертикали x = 10
+    auto dog = CheckMove(road_graph, 11., MakeDog(road_graph, 0, {1., 0.}, Direction::RIGHT));
+    CHECK(dog.pos == Position{10.4, 0.});
+
+    // Дорога (5, 0) - (5, 10) примыкает к (10, 10) - (0, 10) концом: собака сворачивает на неё
+    dog = CheckMove(road_graph, 3., MakeDog(road_graph, 3, {5., 10.}, Direction::UP));
+    CHECK(dog.corridor == road_graph.GetCorridorOfRoad(6));
+    CHECK(std::abs(dog.pos.y - 7.) < 1e-9);
+
+    // Через середину дороги (5, 0) - (5, 10) на неё не свернуть: собака останавливается у края (0, 5) - (20, 5)
+    dog = CheckMove(road_graph, 3., MakeDog(road_graph, 5, {5., 5.}, Direction::UP));
+    CHECK(dog.corridor == road_graph.GetCorridorOfRoad(5));
+    CHECK(dog.speed == Speed{});
+    dog.dir = Direction::LEFT;
+    dog.speed = GetSpeed(Direction::LEFT);
+    CheckMove(road_graph, 1., dog);
+
+    // Собака, сместившаяся поперёк дороги в пределах её ширины, поворачивает по округлённой координате
+    for (double x : {4.6, 5.3}) {
+        dog = CheckMove(road_graph, 3., MakeDog(road_graph, 3, {x, 10.}, Direction::UP));
+        CHECK(dog.corridor == road_graph.GetCorridorOfRoad(6));
+    }
+    // А сместившаяся дальше 0.4 - нет
+    dog = CheckMove(road_graph, 3., MakeDog(road_graph, 3, {5.5, 10.}, Direction::UP));
+    CHECK(dog.corridor == road_graph.GetCorridorOfRoad(3));
+}
+
+TEST_CASE("MoveDog replays random walks like the old MoveDog functions", "[MoveDog]") {
+    constexpr int size = 8;
+    constexpr int step = 4;
+    const RoadGraph road_graph = MakeGridRoadGraph(size, step);
+
+    std::mt19937 random{42};
+    auto dogs = MakeGridDogs(road_graph, 200, size, step, random);
+    auto expected_dogs = dogs;
+
+    // Время тика кратно 0.1, поэтому собаки часто оказываются точно на перекрёстках и у границ
+    std::uniform_int_distribution<int> shift_dist(1, 60);
+    std::uniform_int_distribution<int> dir_dist(0, 5);
+    for (int tick = 0; tick < 200; ++tick) {
+        const double shift_time = shift_dist(random) / 10.;
+        for (size_t i = 0; i < dogs.size(); ++i) {
+            // Иногда игрок меняет направление, как это делает Dog::SetMovementParameters
+            if (auto dir = dir_dist(random); dir < 4) {
+                dogs[i].dir = expected_dogs[i].dir = static_cast<Direction>(dir);
+                dogs[i].speed = expected_dogs[i].speed = GetSpeed(dogs[i].dir);
+            }
+
+            reference::MoveDog(road_graph, shift_time, expected_dogs[i]);
+            MoveDog(road_graph, shift_time, dogs[i]);
+        }
+        REQUIRE(dogs == expected_dogs);
+    }
+}
+
+TEST_CASE("MoveDog benchmark", "[.][benchmark][MoveDog]") {
+    constexpr int size = 32;
+    constexpr int step = 8;
+    const RoadGraph road_graph = MakeGridRoadGraph(size, step);
+
+    std::mt19937 random{42};
+    const auto dogs = MakeGridDogs(road_graph, 10'000, size, step, random);
+    // Ход длиннее клетки: собаки проходят несколько коридоров, часть упирается в границу карты
+    constexpr double shift_time = 10.;
+
+    BENCHMARK_ADVANCED("old MoveDogRight/Left/Up/Down")(Catch::Benchmark::Chronometer meter) {
+        std::vector<std::vector<DogMovement>> runs(meter.runs(), dogs);
+        meter.measure([&](int run) {
+            for (auto& dog : runs[run]) {
+                reference::MoveDog(road_graph, shift_time, dog);
+            }
+        });
+    };
+
+    BENCHMARK_ADVANCED("MoveDog<Direction>")(Catch::Benchmark::Chronometer meter) {
+        std::vector<std::vector<DogMovement>> runs(meter.runs(), dogs);
+        meter.measure([&](int run) {
+            for (auto& dog : runs[run]) {
+                MoveDog(road_graph, shift_time, dog);
+            }
+        });
+    };
+}
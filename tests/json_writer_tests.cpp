@@ -0,0 +1,443 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "game_state_serializer.h"
+#include "json_writer.h"
+#include "model.h"
+
+#include <boost/json.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace model;
+using namespace std::literals;
+
+namespace json = boost::json;
+using http_handler::GameStateSerializer;
+using http_handler::JsonWriter;
+
+namespace {
+    using gmct = GameStateSerializer::gmct;
+    using DogStates = std::vector<std::shared_ptr<const GameSessionSnapshot::DogState>>;
+
+    // Прежняя сериализация через дерево json::value, с которой сравнивается JsonWriter
+    namespace reference {
+        std::string_view DirectionToString(Direction dir) {
+            switch (dir) {
+                case Direction::UP:
+                    return "U";
+                case Direction::LEFT:
+                    return "L";
+                case Direction::RIGHT:
+                    return "R";
+                case Direction::DOWN:
+                    return "D";
+                case Direction::STOP:
+                    break;
+            }
+
+            return "";
+        }
+
+        json::object GetDog(const GameSessionSnapshot::DogState& dog) {
+            json::array bag;
+            for (auto [id, type] : dog.bag) {
+                bag.emplace_back(json::object{{gmct::id, id},
+                                              {gmct::type, type}});
+            }
+
+            return json::object{{gmct::pos, json::array{dog.pos.x, dog.pos.y}},
+                                {gmct::speed, json::array{dog.speed.horizontal, dog.speed.vertical}},
+                                {gmct::dir, DirectionToString(dog.dir)},
+                                {gmct::bag, std::move(bag)},
+                                {gmct::score, dog.score}};
+        }
+
+        std::string SerializeGameState(const GameSessionSnapshot& snapshot) {
+            json::object players;
+            for (const auto& dog : snapshot.dogs) {
+                players.emplace(std::to_string(dog->id), GetDog(*dog));
+            }
+
+            json::object lost_objects;
+            for (const auto& [id, loot] : *snapshot.lost_objects) {
+                lost_objects.emplace(std::to_string(id), json::object{{gmct::type, loot.type},
+                                                                      {gmct::pos, json::array{loot.pos.x, loot.pos.y}}});
+            }
+
+            return json::serialize(json::object{{gmct::players, std::move(players)},
+                                                {gmct::lostObjects, std::move(lost_objects)}});
+        }
+
+        std::string SerializeDogsList(const DogStates& dogs) {
+            json::object players;
+            for (const auto& dog : dogs) {
+                players.emplace(std::to_string(dog->id), json::object{{gmct::name, dog->name}});
+            }
+
+            return json::serialize(players);
+        }
+    }  // namespace reference
+
+    // Применяет разностный ответ к состоянию, которое клиент получил в версии since
+    void ApplyDelta(json::object& state, const json::object& delta) {
+        auto& players = state.at(gmct::players).as_object();
+        for (const auto& dog : delta.at(gmct::players).as_object()) {
+            players[dog.key()] = dog.value();
+        }
+
+        auto& lost_objects = state.at(gmct::lostObjects).as_object();
+        for (const auto& loot : delta.at(gmct::lostObjects).as_object()) {
+            lost_objects[loot.key()] = loot.value();
+        }
+        for (const auto& id : delta.at(gmct::removedLostObjects).as_array()) {
+            lost_objects.erase(std::to_string(json::value_to<std::uint64_t>(id)));
+        }
+    }
+
+    // Полный ответ из разностного с признаком full: без полей version и full
+    json::object WithoutDeltaFields(json::object delta) {
+        delta.erase(gmct::version);
+        delta.erase(gmct::full);
+        return delta;
+    }
+
+    // Имена, которые json::serializer экранирует: кавычки, обратная косая черта, управляющие символы
+    const std::vector<std::string> kNames{
+            "Шарик"s, "Bob \"the dog\""s, "back\\slash"s, "new\nline\ttab"s, "\x01\x1f\x7f"s,
+            "</script>"s, ""s, "😀 emoji"s, "a\0b"s};
+
+    // Карта-решётка из size x size дорог с шагом step, офис в начале координат
+    class TestMap {
+    public:
+        TestMap(int size, int step)
+                : map_(Map::Id{"test"s}, "Test map"s, 3., {{0, 10}, {1, 20}, {2, 30}}, 3) {
+            const Coord end = (size - 1) * step;
+            for (Coord i = 0; i < size; ++i) {
+                map_.AddRoad(Road{Road::HORIZONTAL, {0, i * step}, end});
+                map_.AddRoad(Road{Road::VERTICAL, {i * step, 0}, end});
+            }
+            map_.SetRoadGraph(RoadGraph{map_.GetRoads()});
+            map_.AddOffice(Office{Office::Id{"o0"s}, {0, 0}, {0, 0}});
+        }
+
+        const Map* Get() const {
+            return &map_;
+        }
+
+    private:
+        Map map_;
+    };
+
+    // Игровая сессия с собаками, которые случайно меняют направление, подбирают и сдают предметы
+    class TestSession {
+    public:
+        TestSession(const Map* map, size_t dogs_count, unsigned seed)
+                : session_(map, true, 100., 0.5)
+                , random_(seed) {
+            for (unsigned id = 0; id < dogs_count; ++id) {
+                std::string name = kNames[id % kNames.size()] + std::to_string(id);
+                session_.AddDog(&dogs_.emplace_back(std::move(name), id));
+            }
+        }
+
+        const GameSession& Get() const {
+            return session_;
+        }
+
+        void Tick() {
+            std::uniform_int_distribution<int> dir_dist(0, 9);
+            std::uniform_int_distribution<int> shift_dist(1, 10);
+            for (auto& dog : dogs_) {
+                // Направление меняет примерно каждая вторая собака, поэтому часть фрагментов остаётся прежней
+                if (auto dir = dir_dist(random_); dir <= static_cast<int>(Direction::STOP)) {
+                    dog.SetMovementParameters(static_cast<Direction>(dir), session_.GetMap()->GetDogSpeed());
+                }
+            }
+            session_.SetTimeShift(shift_dist(random_) / 10.);
+        }
+
+    private:
+        GameSession session_;
+        std::deque<Dog> dogs_;
+        std::mt19937 random_;
+    };
+}  // namespace
+
+TEST_CASE("JsonWriter writes the same bytes as json::serialize", "[JsonWriter]") {
+    SECTION("strings") {
+        for (const auto& name : kNames) {
+            std::string text;
+            JsonWriter{text}.String(name);
+            CHECK(text == json::serialize(json::value(name)));
+        }
+    }
+
+    SECTION("numbers") {
+        const std::vector<double> doubles{0., -0., 1., -1., 0.1, 1. / 3., 5.4, 1e-7, 1e21, 123456.789,
+                                          std::numeric_limits<double>::min(), std::numeric_limits<double>::max()};
+        for (double value : doubles) {
+            std::string text;
+            JsonWriter{text}.Double(value);
+            CHECK(text == json::serialize(json::value(value)));
+        }
+
+        for (std::uint64_t value : {std::uint64_t{0}, std::uint64_t{42}, std::numeric_limits<std::uint64_t>::max()}) {
+            std::string text;
+            JsonWriter{text}.UInt(value);
+            CHECK(text == json::serialize(json::value(value)));
+        }
+    }
+
+    SECTION("objects and arrays") {
+        std::string text;
+        JsonWriter writer{text};
+        writer.BeginObject();
+        writer.Key("empty").BeginObject().EndObject();
+        writer.Key("list").BeginArray().UInt(1).BeginArray().EndArray().String("x"sv).Double(2.5).EndArray();
+        writer.Key(7).BeginObject().Key("k\"ey").Raw("[true,null]"sv).EndObject();
+        writer.EndObject();
+
+        CHECK(text == json::serialize(json::object{{"empty", json::object{}},
+                                                   {"list", json::array{1u, json::array{}, "x", 2.5}},
+                                                   {"7", json::object{{"k\"ey", json::array{true, nullptr}}}}}));
+    }
+}
+
+TEST_CASE("Game state body matches the json::value serializer", "[JsonWriter]") {
+    const TestMap map{6, 4};
+    TestSession session{map.Get(), 50, 42};
+    GameStateSerializer serializer;
+
+    for (int tick = 0; tick < 400; ++tick) {
+        session.Tick();
+        // Иногда состояние долго не запрашивают, и история снимка перестаёт покрывать собранную версию
+        if (tick % 200 >= 50 && tick % 200 < 190) {
+            continue;
+        }
+
+        auto snapshot = session.Get().GetSnapshot();
+        auto body = serializer.GetGameState(&session.Get());
+        REQUIRE(body->version == snapshot->version);
+        REQUIRE(body->text == reference::SerializeGameState(*snapshot));
+    }
+}
+
+TEST_CASE("Game state delta turns the state at since into the current state", "[GameStateSerializer]") {
+    const TestMap map{6, 4};
+    TestSession session{map.Get(), 50, 7};
+    GameStateSerializer serializer;
+    std::mt19937 random{7};
+
+    // Полные состояния, полученные клиентом в каждой версии
+    std::map<std::uint64_t, json::object> states;
+    size_t full_deltas = 0;
+    size_t unseen_lost_objects = 0;
+
+    for (int tick = 0; tick < 300; ++tick) {
+        session.Tick();
+        const auto snapshot = session.Get().GetSnapshot();
+        const std::uint64_t version = snapshot->version;
+        const auto& history = snapshot->history;
+        const json::object& state = states[version] = json::parse(serializer.GetGameState(&session.Get())->text).as_object();
+
+        // since и до истории, и после текущей версии
+        std::uniform_int_distribution<std::uint64_t> since_dist(version > 160 ? version - 160 : 0, version + 3);
+        for (int request = 0; request < 5; ++request) {
+            const std::uint64_t since = since_dist(random);
+            INFO("version " << version << ", since " << since);
+
+            const json::object delta = json::parse(serializer.GetGameStateDelta(&session.Get(), since)->text).as_object();
+            REQUIRE(json::value_to<std::uint64_t>(delta.at(gmct::version)) == version);
+
+            const bool in_history = since >= history.front()->version && since <= version;
+            REQUIRE(delta.at(gmct::full).as_bool() == !in_history);
+            if (!in_history) {
+                ++full_deltas;
+                REQUIRE(WithoutDeltaFields(delta) == state);
+                continue;
+            }
+
+            json::object old_state = states.at(since);
+            const auto& old_lost_objects = old_state.at(gmct::lostObjects).as_object();
+            const auto& lost_objects = state.at(gmct::lostObjects).as_object();
+            const auto& delta_lost_objects = delta.at(gmct::lostObjects).as_object();
+            const auto& removed_lost_objects = delta.at(gmct::removedLostObjects).as_array();
+
+            // Приходят только предметы, которых клиент не видел, удаляются только те, что он видел
+            for (const auto& loot : delta_lost_objects) {
+                CHECK_FALSE(old_lost_objects.contains(loot.key()));
+                CHECK(lost_objects.contains(loot.key()));
+            }
+            for (const auto& id : removed_lost_objects) {
+                const std::string key = std::to_string(json::value_to<std::uint64_t>(id));
+                CHECK(old_lost_objects.contains(key));
+                CHECK_FALSE(lost_objects.contains(key));
+            }
+
+            // Предмет, появившийся и подобранный между since и текущей версией, клиенту не упоминается
+            for (auto it = states.upper_bound(since); it != states.end() && it->first < version; ++it) {
+                for (const auto& loot : it->second.at(gmct::lostObjects).as_object()) {
+                    if (old_lost_objects.contains(loot.key()) || lost_objects.contains(loot.key())) {
+                        continue;
+                    }
+                    ++unseen_lost_objects;
+                    const std::string key{loot.key().data(), loot.key().size()};
+                    CHECK_FALSE(delta_lost_objects.contains(key));
+                    for (const auto& id : removed_lost_objects) {
+                        CHECK(std::to_string(json::value_to<std::uint64_t>(id)) != key);
+                    }
+                }
+            }
+
+            ApplyDelta(old_state, delta);
+            REQUIRE(old_state == state);
+        }
+    }
+
+    CHECK(full_deltas > 0);
+    CHECK(unseen_lost_objects > 0);
+}
+
+TEST_CASE("Game state delta is consistent under concurrent requests", "[GameStateSerializer]") {
+    const TestMap map{6, 4};
+    TestSession session{map.Get(), 50, 11};
+    GameStateSerializer serializer;
+
+    // Полные состояния всех версий, опубликованных тиками
+    std::map<std::uint64_t, json::object> states;
+    states[session.Get().GetSnapshot()->version]
+            = json::parse(reference::SerializeGameState(*session.Get().GetSnapshot())).as_object();
+
+    struct Response {
+        std::uint64_t since;
+        std::string text;
+    };
+    constexpr unsigned readers_count = 4;
+    std::vector<std::vector<Response>> responses(readers_count);
+    std::atomic<bool> done = false;
+
+    // Читатели запрашивают изменения с близких версий, поэтому часто попадают в один и тот же кэш ответов
+    std::vector<std::thread> readers;
+    for (unsigned reader = 0; reader < readers_count; ++reader) {
+        readers.emplace_back([&, reader] {
+            std::mt19937 random{reader};
+            while (!done.load(std::memory_order_acquire)) {
+                const std::uint64_t version = session.Get().GetSnapshot()->version;
+                std::uniform_int_distribution<std::uint64_t> since_dist(version > 10 ? version - 10 : 0, version);
+                const std::uint64_t since = since_dist(random);
+                responses[reader].push_back({since, serializer.GetGameStateDelta(&session.Get(), since)->text});
+            }
+        });
+    }
+
+    for (int tick = 0; tick < 200; ++tick) {
+        session.Tick();
+        const auto snapshot = session.Get().GetSnapshot();
+        states[snapshot->version] = json::parse(reference::SerializeGameState(*snapshot)).as_object();
+    }
+    done.store(true, std::memory_order_release);
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    size_t checked = 0;
+    for (const auto& reader_responses : responses) {
+        for (const auto& [since, text] : reader_responses) {
+            const json::object delta = json::parse(text).as_object();
+            const std::uint64_t version = json::value_to<std::uint64_t>(delta.at(gmct::version));
+            INFO("version " << version << ", since " << since);
+            REQUIRE(version >= since);
+            REQUIRE(states.contains(version));
+
+            if (delta.at(gmct::full).as_bool()) {
+                REQUIRE(WithoutDeltaFields(delta) == states.at(version));
+                continue;
+            }
+            REQUIRE(states.contains(since));
+
+            json::object old_state = states.at(since);
+            ApplyDelta(old_state, delta);
+            REQUIRE(old_state == states.at(version));
+            ++checked;
+        }
+    }
+
+    CHECK(checked > 0);
+}
+
+TEST_CASE("Dogs list matches the json::value serializer", "[JsonWriter]") {
+    const TestMap map{2, 4};
+    TestSession session{map.Get(), 30, 1};
+
+    session.Tick();
+    const auto& dogs = session.Get().GetSnapshot()->dogs;
+    REQUIRE(dogs.size() == 30);
+    CHECK(GameStateSerializer::SerializeDogsList(dogs) == reference::SerializeDogsList(dogs));
+    CHECK(GameStateSerializer::SerializeDogsList({}) == reference::SerializeDogsList({}));
+}
+
+TEST_CASE("Join and action are visible in the game state before the next tick", "[GameSession]") {
+    const TestMap map{2, 4};
+    GameSession session{map.Get(), false, 1000., 0.};
+    GameStateSerializer serializer;
+    std::deque<Dog> dogs;
+
+    const auto get_dog_state = [&] {
+        const auto state = json::parse(serializer.GetGameState(&session)->text);
+        return state.as_object().at(gmct::players).as_object().at("0").as_object();
+    };
+
+    // Запросы на strand'е карты публикуют изменения через PublishChanges, тиков между ними нет
+    session.AddDog(&dogs.emplace_back("dog0"s, 0));
+    session.PublishChanges();
+    CHECK(get_dog_state().at(gmct::speed) == json::value(json::array{0., 0.}));
+    CHECK(get_dog_state().at(gmct::dir) == json::value("U"));
+
+    dogs[0].SetMovementParameters(Direction::RIGHT, map.Get()->GetDogSpeed());
+    session.PublishChanges();
+    CHECK(get_dog_state().at(gmct::speed) == json::value(json::array{3., 0.}));
+    CHECK(get_dog_state().at(gmct::dir) == json::value("R"));
+
+    // Без изменений новый снимок не публикуется
+    const auto version = session.GetSnapshot()->version;
+    session.PublishChanges();
+    CHECK(session.GetSnapshot()->version == version);
+}
+
+TEST_CASE("JsonWriter benchmark", "[.][benchmark][JsonWriter]") {
+    const TestMap map{16, 8};
+    TestSession session{map.Get(), 1'000, 42};
+    for (int tick = 0; tick < 20; ++tick) {
+        session.Tick();
+    }
+    const auto snapshot = session.Get().GetSnapshot();
+
+    BENCHMARK("state: json::value + json::serialize") {
+        return reference::SerializeGameState(*snapshot);
+    };
+
+    // Новый сериализатор ещё не собрал фрагменты и пишет все собаки и предметы заново
+    BENCHMARK_ADVANCED("state: JsonWriter")(Catch::Benchmark::Chronometer meter) {
+        std::vector<GameStateSerializer> serializers(meter.runs());
+        meter.measure([&](int run) {
+            return serializers[run].GetGameState(&session.Get());
+        });
+    };
+
+    BENCHMARK("dogs list: json::value + json::serialize") {
+        return reference::SerializeDogsList(snapshot->dogs);
+    };
+
+    BENCHMARK("dogs list: JsonWriter") {
+        return GameStateSerializer::SerializeDogsList(snapshot->dogs);
+    };
+}